@@ -0,0 +1,31 @@
+# This version of config.mk was generated by:
+# ./configure
+# Any changes made here will be lost if configure is re-run
+SRCDIR = .
+PREFIX = /usr/local
+EXEC_PREFIX = $(PREFIX)
+BINDIR = $(EXEC_PREFIX)/bin
+DOCPREFIX = $(PREFIX)/share/doc
+MANPREFIX = $(PREFIX)/share/man
+SHAREPREFIX = $(PREFIX)/share
+CC = cc
+CFLAGS = -Wall -pipe -Wno-override-init -O2 -ffunction-sections -fdata-sections -fPIE
+LDFLAGS = -Wl,-z,now -Wl,-z,relro
+CFLAGS_STD = -std=c99 -DNDEBUG -pthread
+LDFLAGS_STD = -lc -pthread
+CFLAGS_AUTO = -fstack-protector-all
+LDFLAGS_AUTO = -Wl,--gc-sections -pie
+CFLAGS_DEBUG = -U_FORTIFY_SOURCE -UNDEBUG -O0 -g3 -ggdb -Wall -Wextra -pedantic -Wno-missing-field-initializers -Wno-unused-parameter
+CFLAGS_TERMKEY = -DTERMINFO='"/root/miniconda/share/terminfo"' -DTERMINFO_DIRS='"/root/miniconda/share/terminfo"'
+CFLAGS_CURSES = -D_DEFAULT_SOURCE -D_XOPEN_SOURCE=600  -DCONFIG_CURSES=1
+LDFLAGS_CURSES = -lncursesw -ltinfo 
+CFLAGS_TRE = 
+LDFLAGS_TRE = 
+CFLAGS_LUA = 
+LDFLAGS_LUA = 
+CFLAGS_LPEG = 
+LDFLAGS_LPEG = 
+CFLAGS_ACL = 
+LDFLAGS_ACL = 
+CFLAGS_SELINUX = 
+LDFLAGS_SELINUX = 
@@ -1097,7 +1097,7 @@ termkey_interpret_modereport(TermKey *tk, const TermKeyKey *key, int *initial, i
 		*initial = key->code.mouse[0];
 
 	if (mode)
-		*mode = (key->code.mouse[1] << 8) | key->code.mouse[2];
+		*mode = ((unsigned char)key->code.mouse[1] << 8) | (unsigned char)key->code.mouse[2];
 
 	if (value)
 		*value = key->code.mouse[3];
@@ -1867,6 +1867,28 @@ termkey_getkey_force(TermKey *tk, TermKeyKey *key)
 	return result;
 }
 
+/*
+ * Raw access to buffered input not yet consumed as keys, allows callers to
+ * handle data which should not be interpreted as keys e.g. bracketed pastes.
+ */
+TERMKEY_EXPORT const unsigned char *
+termkey_peek_bytes(TermKey *tk, size_t *len)
+{
+	if (tk->hightide) {
+		tk->buffstart += tk->hightide;
+		tk->buffcount -= tk->hightide;
+		tk->hightide   = 0;
+	}
+	*len = tk->buffcount;
+	return tk->buffer + tk->buffstart;
+}
+
+TERMKEY_EXPORT void
+termkey_consume_bytes(TermKey *tk, size_t count)
+{
+	termkey_eat_bytes(tk, count);
+}
+
 TERMKEY_EXPORT TermKeyResult
 termkey_advisereadable(TermKey *tk)
 {
@@ -1368,7 +1368,8 @@ int main(int argc, char *argv[])
 	    sigaction(SIGCONT, &sa, NULL) == -1 ||
 	    sigaction(SIGWINCH, &sa, NULL) == -1 ||
 	    sigaction(SIGTERM, &sa, NULL) == -1 ||
-	    sigaction(SIGHUP, &sa, NULL) == -1) {
+	    sigaction(SIGHUP, &sa, NULL) == -1 ||
+	    sigaction(SIGCHLD, &sa, NULL) == -1) {
 		vis_die(vis, "Failed to set signal handler: %s\n", strerror(errno));
 	}
 
@@ -1383,6 +1384,7 @@ int main(int argc, char *argv[])
 	sigaddset(&blockset, SIGWINCH);
 	sigaddset(&blockset, SIGTERM);
 	sigaddset(&blockset, SIGHUP);
+	sigaddset(&blockset, SIGCHLD);
 	if (sigprocmask(SIG_BLOCK, &blockset, NULL) == -1)
 		vis_die(vis, "Failed to block signals\n");
 
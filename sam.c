@@ -35,6 +35,7 @@ struct SamChange {
 	Filerange range;   /* inserts are denoted by zero sized range (same start/end) */
 	const char *data;  /* will be free(3)-ed after transcript has been processed */
 	size_t len;        /* size in bytes of the chunk pointed to by data */
+	TextInput input;   /* content already stored in the text, used instead of data if non-empty */
 	SamChange *next;   /* modification position increase monotonically */
 	int count;         /* how often should data be inserted? */
 };
@@ -60,6 +61,7 @@ struct Command {
 	Count count;              /* command count, defaults to [0,+inf] */
 	int iteration;            /* current command loop iteration */
 	char flags;               /* command specific flags */
+	bool background;          /* whether a filter or save runs in the background, see vis-filter.c */
 	Command *cmd;             /* target of x, y, g, v, X, Y, { */
 	Command *next;            /* next command in {} group */
 };
@@ -303,6 +305,7 @@ const char *sam_error(enum SamError err) {
 static void sam_change_free(SamChange *c) {
 	if (!c)
 		return;
+	text_input_discard(c->win->file->text, &c->input);
 	free((char*)c->data);
 	free(c);
 }
@@ -384,6 +387,28 @@ static bool sam_change(Win *win, Selection *sel, Filerange range, const char *da
 	return c;
 }
 
+/* like sam_change, but takes over content already stored in the text */
+static bool sam_change_input(Win *win, Selection *sel, Filerange range, TextInput *input)
+{
+	SamChange *c = sam_change_new(&win->file->transcript, TRANSCRIPT_CHANGE, range, win, sel);
+	if (c) {
+		c->input = *input;
+		c->len = input->len;
+		c->count = 1;
+		*input = (TextInput){0};
+	}
+	return c;
+}
+
+static bool sam_change_newline(const SamChange *c)
+{
+	for (VisDACount i = 0; i < c->input.count; i++) {
+		if (c->input.data[i].lines > 0)
+			return true;
+	}
+	return c->data && memory_scan_forward(c->data, '\n', c->len);
+}
+
 static Address *address_new(void) {
 	Address *addr = calloc(1, sizeof *addr);
 	if (addr)
@@ -1075,6 +1100,14 @@ enum SamError sam_cmd(Vis *vis, const char *s) {
 		sam_transcript_init(&file->transcript);
 	}
 
+	/* a lone filter entered at the prompt for a single selection does not
+	 * block the editor, its output is applied once the command terminated,
+	 * likewise a lone write is committed in the background (vis-save.c) */
+	const CommandDef *def = cmd->cmd->cmddef;
+	cmd->cmd->background = vis->prompt_interactive &&
+	                       ((def->func == cmd_filter && vis->win && vis->win->view.selection_count == 1) ||
+	                        def->func == cmd_write);
+
 	bool visual = vis->mode->visual;
 	size_t primary_pos = vis->win ? view_cursor_get(&vis->win->view) : EPOS;
 	Filerange range = text_range_empty();
@@ -1090,25 +1123,44 @@ enum SamError sam_cmd(Vis *vis, const char *s) {
 			continue;
 		}
 		vis_file_snapshot(vis, file);
+		/* apply all changes at once, afterwards update the selections
+		 * with the positions they refer to in the modified text */
+		TextEditList edits = {0};
 		ptrdiff_t delta = 0;
 		for (SamChange *c = t->changes; c; c = c->next) {
+			Filerange range = c->range;
 			c->range.start += delta;
 			c->range.end += delta;
 			if (c->type & TRANSCRIPT_DELETE) {
-				text_delete_range(file->text, c->range);
-				delta -= text_range_size(c->range);
-				if (c->sel && c->type == TRANSCRIPT_DELETE) {
-					if (visual)
-						view_selections_dispose_force(c->sel);
-					else
-						view_cursors_to(c->sel, c->range.start);
-				}
+				*da_push(vis, &edits) = (TextEdit){ .range = range };
+				delta -= text_range_size(range);
 			}
 			if (c->type & TRANSCRIPT_INSERT) {
 				for (int i = 0; i < c->count; i++) {
-					text_insert(vis, file->text, c->range.start, c->data, c->len);
-					delta += c->len;
+					*da_push(vis, &edits) = (TextEdit){
+						.range = text_range_new(range.end, range.end),
+						.data = c->data,
+						.len = c->len,
+						.input = c->input.count ? &c->input : NULL,
+					};
 				}
+				delta += c->len * c->count;
+			}
+		}
+		bool applied = text_edit_batch(vis, file->text, edits.data, edits.count);
+		da_release(&edits);
+		if (!applied)
+			vis_info_show(vis, "Failed to apply changes");
+
+		for (SamChange *c = t->changes; c; c = c->next) {
+			/* the positions do not refer to the text unless all edits were applied */
+			if (applied && c->sel && c->type == TRANSCRIPT_DELETE) {
+				if (visual)
+					view_selections_dispose_force(c->sel);
+				else
+					view_cursors_to(c->sel, c->range.start);
+			}
+			if (applied && (c->type & TRANSCRIPT_INSERT)) {
 				Filerange r = text_range_new(c->range.start,
 				                             c->range.start + c->len * c->count);
 				if (c->sel) {
@@ -1116,7 +1168,7 @@ enum SamError sam_cmd(Vis *vis, const char *s) {
 						view_selections_set(c->sel, r);
 						c->sel->anchored = true;
 					} else {
-						if (memory_scan_forward(c->data, '\n', c->len))
+						if (sam_change_newline(c))
 							view_cursors_to(c->sel, r.start);
 						else
 							view_cursors_to(c->sel, r.end);
@@ -1129,6 +1181,8 @@ enum SamError sam_cmd(Vis *vis, const char *s) {
 					}
 				}
 			}
+			/* even if only some edits were applied, their content is referenced */
+			text_input_release(&c->input);
 		}
 		sam_transcript_free(&file->transcript);
 		vis_file_snapshot(vis, file);
@@ -1254,14 +1308,13 @@ static int extract(Vis *vis, Win *win, Command *cmd, const char *argv[], Selecti
 		if (nsub > MAX_REGEX_SUB)
 			nsub = MAX_REGEX_SUB;
 		RegexMatch match[MAX_REGEX_SUB];
+		RegexCursor cursor = text_regex_cursor(txt, cmd->regex, *range);
 		while (start <= end) {
 			char c;
 			int flags = start > range->start &&
 			            text_byte_get(txt, start - 1, &c) && c != '\n' ?
 			            REG_NOTBOL : 0;
-			bool found = !text_search_range_forward(txt, start, end - start,
-			                                        cmd->regex, nsub, match,
-			                                        flags);
+			bool found = !text_regex_cursor_next(&cursor, start, nsub, match, flags);
 			Filerange r = text_range_empty();
 			if (found) {
 				if (argv[0][0] == 'x')
@@ -1450,6 +1503,9 @@ static bool cmd_write(Vis *vis, Win *win, Command *cmd, const char *argv[], Sele
 	if (sam_transcript_error(&file->transcript, SAM_ERR_WRITE_CONFLICT))
 		return false;
 
+	/* complete a previous write first, it might target the same file */
+	vis_save_wait(vis);
+
 	Text *text = file->text;
 	Filerange range_all = text_range_new(0, text_size(text));
 	bool write_entire_file = text_range_equal(*r, range_all);
@@ -1556,6 +1612,21 @@ static bool cmd_write(Vis *vis, Win *win, Command *cmd, const char *argv[], Sele
 
 		bool failure = false;
 		bool visual = vis->mode->visual;
+		bool update_stat = same_file || (!existing_file && str8_equal(file->filepath, path));
+
+		/* only an atomic save leaves the file intact until it is committed */
+		if (cmd->background && ctx.method == TEXT_SAVE_ATOMIC) {
+			FilerangeList ranges = {0};
+			for (Selection *s = view_selections(&win->view); s; s = view_selections_next(s)) {
+				*da_push(vis, &ranges) = visual ? view_selections_get(s) : *r;
+				if (!visual)
+					break;
+			}
+			bool started = vis_save_start(vis, file, &ctx, ranges.data, ranges.count, path, update_stat);
+			da_release(&ranges);
+			if (started)
+				continue;
+		}
 
 		for (Selection *s = view_selections(&win->view); s; s = view_selections_next(s)) {
 			Filerange range = visual ? view_selections_get(s) : *r;
@@ -1576,18 +1647,7 @@ static bool cmd_write(Vis *vis, Win *win, Command *cmd, const char *argv[], Sele
 			goto err;
 		}
 
-		if (file->filepath.length == 0) {
-			file->filepath = path;
-			same_file = true;
-		}
-
-		if (same_file || (!existing_file && str8_equal(file->filepath, path)))
-			file->stat = text_stat(text);
-
-		vis_event_emit(vis, VIS_EVENT_FILE_SAVE_POST, file, path.data);
-
-		if (file->filepath.data != path.data)
-			free(path.data);
+		vis_file_saved(vis, file, path, update_stat);
 		continue;
 
 	err:
@@ -1597,27 +1657,39 @@ static bool cmd_write(Vis *vis, Win *win, Command *cmd, const char *argv[], Sele
 	return true;
 }
 
+/* command output is stored in the text as it arrives, see text_input_append */
+typedef struct {
+	Vis *vis;
+	Text *txt;
+	TextInput input;
+} FilterOutput;
+
+static ssize_t read_into_text(void *context, char *data, size_t len) {
+	FilterOutput *out = context;
+	return text_input_append(out->vis, out->txt, &out->input, data, len) ? (ssize_t)len : -1;
+}
+
 static bool cmd_filter(Vis *vis, Win *win, Command *cmd, const char *argv[], Selection *sel, Filerange *range) {
 	if (!win)
 		return false;
+	if (cmd->background)
+		return vis_filter_start(vis, win->file, *range, argv + 1);
 
-	Buffer bufout = {0}, buferr = {0};
+	FilterOutput out = {.vis = vis, .txt = win->file->text};
+	Buffer buferr = {0};
 
-	int status = vis_pipe(vis, win->file, *range, argv + 1, &bufout, read_into_buffer, &buferr,
+	int status = vis_pipe(vis, win->file, *range, argv + 1, &out, read_into_text, &buferr,
 	                      read_into_buffer, false);
 
 	if (vis->interrupted) {
 		vis_info_show(vis, "Command cancelled");
 	} else if (status == 0) {
-		char *data  = bufout.data;
-		bufout.data = 0;
-		if (!sam_change(win, sel, *range, data, bufout.length, 1))
-			free(data);
+		sam_change_input(win, sel, *range, &out.input);
 	} else {
 		vis_info_show(vis, "Command failed %s", buffer_content0(&buferr));
 	}
 
-	buffer_release(&bufout);
+	text_input_discard(out.txt, &out.input);
 	buffer_release(&buferr);
 
 	return !vis->interrupted && status == 0;
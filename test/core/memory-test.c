@@ -0,0 +1,124 @@
+#include "util.h"
+
+#include "tap.h"
+
+#include "util.c"
+
+#include <sys/time.h>
+
+static const struct {
+	MemoryScanLevel level;
+	const char *name;
+} levels[] = {
+	{ MemoryScan_Bytewise, "bytewise" },
+#if defined(__clang__) || defined(__GNUC__)
+	{ MemoryScan_SWAR,     "SWAR"     },
+#endif
+#if MEMORY_SCAN_X86
+	{ MemoryScan_SSE2,     "SSE2"     },
+	{ MemoryScan_AVX2,     "AVX2"     },
+#endif
+};
+
+static bool level_supported(MemoryScanLevel level) {
+#if MEMORY_SCAN_X86
+	if (level == MemoryScan_AVX2)
+		return __builtin_cpu_supports("avx2");
+#endif
+	return true;
+}
+
+static const uint8_t *scan_forward(const uint8_t *s, uint8_t byte, ptrdiff_t n) {
+	for (ptrdiff_t i = 0; i < n; i++) {
+		if (s[i] == byte)
+			return s + i;
+	}
+	return NULL;
+}
+
+static const uint8_t *scan_reverse(const uint8_t *s, uint8_t byte, ptrdiff_t n) {
+	while (n--) {
+		if (s[n] == byte)
+			return s + n;
+	}
+	return NULL;
+}
+
+static u64 count(const uint8_t *s, uint8_t byte, ptrdiff_t n) {
+	u64 result = 0;
+	for (ptrdiff_t i = 0; i < n; i++)
+		result += s[i] == byte;
+	return result;
+}
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* throughput of the kernels over size MiB of text with a line every 80 bytes */
+static void bench(size_t size) {
+	size <<= 20;
+	uint8_t *data = malloc(size);
+	if (!data) {
+		fprintf(stderr, "failed to allocate %zu MiB\n", size >> 20);
+		return;
+	}
+	for (size_t i = 0; i < size; i++)
+		data[i] = i % 80 == 79 ? '\n' : 'a' + i % 26;
+	for (size_t l = 0; l < LENGTH(levels); l++) {
+		if (!level_supported(levels[l].level))
+			continue;
+		memory_scan_level = levels[l].level;
+		double start = now();
+		volatile u64 lines = memory_count(data, '\n', size);
+		double counted = now();
+		volatile void *none = memory_scan_forward(data, 0, size);
+		double forward = now();
+		none = memory_scan_reverse(data, 0, size);
+		double reverse = now();
+		(void)lines;
+		(void)none;
+		printf("%-8s count %6.2f GB/s, forward %6.2f GB/s, reverse %6.2f GB/s\n", levels[l].name,
+		       size / 1e9 / (counted - start), size / 1e9 / (forward - counted),
+		       size / 1e9 / (reverse - forward));
+	}
+	free(data);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench(argc > 2 ? strtoul(argv[2], NULL, 10) : 1024);
+		return 0;
+	}
+
+	plan_no_plan();
+
+	static uint8_t data[300];
+	srand(time(NULL));
+	for (size_t i = 0; i < sizeof data; i++)
+		data[i] = "ab\n\x80\xff"[rand() % 5];
+
+	for (size_t l = 0; l < LENGTH(levels); l++) {
+		skip_if(!level_supported(levels[l].level), 3, "%s not supported", levels[l].name) {
+			memory_scan_level = levels[l].level;
+			bool forward = true, reverse = true, counted = true;
+			/* every alignment and length, including partial blocks on either side */
+			for (size_t off = 0; off < 40; off++) {
+				for (ptrdiff_t n = 0; off + n <= sizeof data; n++) {
+					for (const char *b = "ab\n\x80x"; *b; b++) {
+						forward &= memory_scan_forward(data + off, *b, n) == scan_forward(data + off, *b, n);
+						reverse &= memory_scan_reverse(data + off, *b, n) == scan_reverse(data + off, *b, n);
+						counted &= memory_count(data + off, *b, n) == count(data + off, *b, n);
+					}
+				}
+			}
+			ok(forward, "Scan forward (%s)", levels[l].name);
+			ok(reverse, "Scan reverse (%s)", levels[l].name);
+			ok(counted, "Count (%s)", levels[l].name);
+		}
+	}
+
+	return exit_status();
+}
@@ -87,6 +87,20 @@ static void iterator_find_prev(Text *txt, size_t start, char b, size_t match) {
 	ok((found && it.pos == match) || (!found && it.pos == 0),"Iterator byte find prev (start: %zu, match: %zu)", start, match);
 }
 
+static bool compare_content(Text *txt, const char *data, size_t len) {
+	if (text_size(txt) != len)
+		return false;
+	char *buf = text_bytes_alloc0(txt, 0, len);
+	bool equal = buf && memcmp(buf, data, len) == 0;
+	free(buf);
+	for (size_t pos = 0; equal && pos < len; pos += 7) {
+		char b;
+		Iterator it = text_iterator_get(txt, pos);
+		equal = text_iterator_byte_get(&it, &b) && b == data[pos];
+	}
+	return equal;
+}
+
 static bool text_save_method(Text *txt, const char *filename, enum TextSaveMethod method) {
 	TextSave ctx = text_save_default(.txt = txt, .filepath = str8_from_c_str(filename), .method = method);
 	if (!text_save_begin(&ctx))
@@ -138,6 +152,45 @@ int main(int argc, char *argv[]) {
 			text_free(txt);
 		}
 
+		for (size_t i = 0; i < LENGTH(load_method); i++) {
+			const char *piped = "Hello >World!\n";
+			char out[BUFSIZ];
+			int fds[2] = {-1, -1};
+			ssize_t len = -1;
+			txt = vis_text_load(vis, filename, load_method[i]);
+			if (txt && insert(txt, 6, ">") && pipe(fds) == 0 &&
+			    text_pipe_range(txt, text_range_new(0, text_size(txt)), fds[1]) == (ssize_t)strlen(piped))
+				len = read(fds[0], out, sizeof out);
+			ok(len == (ssize_t)strlen(piped) && memcmp(out, piped, len) == 0, "Pipe text (method %zu)", i);
+			close(fds[0]);
+			close(fds[1]);
+			text_free(txt);
+		}
+
+		{
+			/* the most recently inserted text is changed in place */
+			const char *piped = "Hello World!\n>>";
+			char out[BUFSIZ];
+			int fds[2] = {-1, -1};
+			ssize_t len = -1;
+			txt = vis_text_load(vis, filename, TEXT_LOAD_AUTO);
+			if (txt && insert(txt, 13, ">>") && pipe(fds) == 0 &&
+			    text_pipe_range(txt, text_range_new(0, text_size(txt)), fds[1]) == (ssize_t)strlen(piped) &&
+			    insert(txt, 14, "<"))
+				len = read(fds[0], out, sizeof out);
+			ok(len == (ssize_t)strlen(piped) && memcmp(out, piped, len) == 0, "Pipe text modified afterwards");
+
+			/* a full non-blocking pipe is not waited upon */
+			bool full = fds[1] != -1 && fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0;
+			while (full && write(fds[1], out, sizeof out) > 0);
+			errno = 0;
+			ok(full && text_pipe_range(txt, text_range_new(0, text_size(txt)), fds[1]) == -1 &&
+			   errno == EAGAIN, "Pipe text to full non-blocking pipe");
+			close(fds[0]);
+			close(fds[1]);
+			text_free(txt);
+		}
+
 		enum TextSaveMethod save_method[] = {
 			TEXT_SAVE_AUTO,
 			TEXT_SAVE_ATOMIC,
@@ -164,6 +217,112 @@ int main(int argc, char *argv[]) {
 			}
 		}
 
+		/* in-place saves over the mmap-ed file only rewrite what changed */
+		size_t size = 5 * sysconf(_SC_PAGESIZE) + 123;
+		char *orig = malloc(size + 1), *data = malloc(size + 64);
+		for (size_t i = 0; orig && i < size; i++)
+			orig[i] = i % 64 == 63 ? '\n' : 'a' + rand() % 26;
+		FILE *file = orig && data ? fopen(filename, "w") : NULL;
+		bool written = file && fwrite(orig, 1, size, file) == size;
+		if (file)
+			fclose(file);
+		txt = written ? vis_text_load(vis, filename, TEXT_LOAD_MMAP) : NULL;
+		ok(txt && compare_content(txt, orig, size), "Load mmap-ed");
+
+		const struct {
+			size_t pos, del;
+			const char *ins;
+			const char *name;
+		} edits[] = {
+			{ size / 2, 0, "inserted", "insertion" },
+			{ 100,     10, "",         "deletion"  },
+			{ size - 5000, 5000, "",   "truncation" },
+			{ 0,        0, "prepended", "prepend"   },
+		};
+		size_t len = size;
+		if (data)
+			memcpy(data, orig, size);
+		for (size_t i = 0; i < LENGTH(edits); i++) {
+			size_t pos = edits[i].pos, del = edits[i].del, ins = strlen(edits[i].ins);
+			if (pos + del > len)
+				pos = len - del;
+			bool edited = txt && text_delete(txt, pos, del) && insert(txt, pos, edits[i].ins);
+			if (edited) {
+				text_snapshot(txt);
+				memmove(data + pos + ins, data + pos + del, len - pos - del);
+				memcpy(data + pos, edits[i].ins, ins);
+				len += ins - del;
+			}
+			ok(edited && text_save_method(txt, filename, TEXT_SAVE_INPLACE), "Save in-place %s", edits[i].name);
+			Text *saved = vis_text_load(vis, filename, TEXT_LOAD_READ);
+			ok(saved && compare_content(saved, data, len) && compare_content(txt, data, len), "Verify in-place %s", edits[i].name);
+			text_free(saved);
+		}
+
+		while (txt && text_undo(txt) != EPOS);
+		ok(txt && compare_content(txt, orig, size) && text_save_method(txt, filename, TEXT_SAVE_INPLACE), "Save in-place undone");
+		Text *saved = vis_text_load(vis, filename, TEXT_LOAD_READ);
+		ok(saved && compare_content(saved, orig, size), "Verify in-place undone");
+		text_free(saved);
+		text_free(txt);
+
+		/* an atomic save replaces the mmap-ed file, which hence can no longer be rewritten */
+		size_t page = sysconf(_SC_PAGESIZE);
+		txt = vis_text_load(vis, filename, TEXT_LOAD_MMAP);
+		bool replaced = txt && text_delete(txt, 0, 2 * page) && text_save_method(txt, filename, TEXT_SAVE_ATOMIC);
+		ok(replaced && text_undo(txt) == 0 && text_save_method(txt, filename, TEXT_SAVE_INPLACE), "Save in-place after atomic save");
+		saved = vis_text_load(vis, filename, TEXT_LOAD_READ);
+		ok(saved && compare_content(saved, orig, size), "Verify in-place after atomic save");
+		text_free(saved);
+		text_free(txt);
+
+		/* unmodified parts of the mmap-ed file are copied by the kernel */
+		txt = vis_text_load(vis, filename, TEXT_LOAD_MMAP);
+		if (txt && data && insert(txt, size / 3, "inserted")) {
+			memcpy(data, orig, size / 3);
+			memcpy(data + size / 3, "inserted", 8);
+			memcpy(data + size / 3 + 8, orig + size / 3, size - size / 3);
+		}
+		ok(txt && text_save_method(txt, filename, TEXT_SAVE_ATOMIC), "Save atomic copy");
+		saved = vis_text_load(vis, filename, TEXT_LOAD_READ);
+		ok(saved && compare_content(saved, data, size + 8) && compare_content(txt, data, size + 8), "Verify atomic copy");
+		text_free(saved);
+
+		/* commit a snapshot of the text while it is modified */
+		TextSave ctx = text_save_default(.txt = txt, .filepath = str8_from_c_str(filename), .method = TEXT_SAVE_ATOMIC);
+		Filerange all = text_range_new(0, txt ? text_size(txt) : 0);
+		bool begun = txt && text_save_begin(&ctx), snapshot = begun && text_save_snapshot(&ctx, &all, 1);
+		if (begun && !snapshot)
+			text_save_cancel(&ctx);
+		bool modified = snapshot && insert(txt, 0, "modified") && text_modified(txt);
+		bool committed = snapshot && text_save_commit_snapshot(&ctx);
+		if (committed)
+			text_mark_saved(&ctx);
+		ok(modified && committed && text_modified(txt), "Save in the background");
+		ok(txt && text_undo(txt) == 0 && !text_modified(txt), "Undo to revision saved in the background");
+		saved = vis_text_load(vis, filename, TEXT_LOAD_READ);
+		ok(saved && compare_content(saved, data, size + 8), "Verify save in the background");
+		text_free(saved);
+
+		/* the most recently modified piece is changed in place, it has to be copied */
+		ctx = text_save_default(.txt = txt, .filepath = str8_from_c_str(filename), .method = TEXT_SAVE_ATOMIC);
+		begun = txt && text_save_begin(&ctx);
+		all = text_range_new(0, txt ? text_size(txt) + 6 : 0);
+		snapshot = begun && insert(txt, 0, "cached") && text_save_snapshot(&ctx, &all, 1);
+		if (begun && !snapshot)
+			text_save_cancel(&ctx);
+		bool copied = snapshot && ctx.copy && text_delete(txt, 1, 2) && text_save_commit_snapshot(&ctx);
+		if (data) {
+			memmove(data + 6, data, size + 8);
+			memcpy(data, "cached", 6);
+		}
+		saved = vis_text_load(vis, filename, TEXT_LOAD_READ);
+		ok(copied && saved && compare_content(saved, data, size + 14), "Save snapshot of modified piece");
+		text_free(saved);
+		text_free(txt);
+		free(orig);
+		free(data);
+
 		int (*creation[])(const char*, const char*) = { symlink, link };
 		const char *names[] = { "symlink", "hardlink" };
 
@@ -238,14 +397,19 @@ int main(int argc, char *argv[]) {
 	/* test cached insertion (i.e. in-place with only one piece) */
 	ok(insert(txt, 0, "3") && compare(txt, "3"), "Inserting into empty document (cached)");
 	ok(insert(txt, 0, "1") && compare(txt, "13"), "Inserting at begin (cached)");
+	size_t version = text_version(txt);
 	ok(insert(txt, 1, "2") && compare(txt, "123"), "Inserting in middle (cached)");
+	ok(text_version(txt) != version, "Version changed by cached insertion");
 	ok(insert(txt, text_size(txt), "4") && compare(txt, "1234"), "Inserting at end (cached)");
 
+	version = text_version(txt);
 	ok(text_delete(txt, text_size(txt), 0) && compare(txt, "1234"), "Deleting empty range");
 	ok(!text_delete(txt, text_size(txt), 1) && compare(txt, "1234"), "Deleting invalid offset");
 	ok(!text_delete(txt, 0, text_size(txt)+5) && compare(txt, "1234"), "Deleting invalid range");
+	ok(text_version(txt) == version, "Version unchanged without modification");
 
 	ok(text_undo(txt) == 0 && compare(txt, ""), "Reverting to empty document");
+	ok(text_version(txt) != version, "Version changed by undo");
 	ok(text_redo(txt) != EPOS /* == text_size(txt) */ && compare(txt, "1234"), "Restoring previsous content");
 
 	/* test cached deletion (i.e. in-place with only one piece) */
@@ -411,5 +575,236 @@ int main(int argc, char *argv[]) {
 
 	text_free(txt);
 
+	/* random modifications resulting in a long piece chain */
+	enum { EDITS = 2000, CONTENT_MAX = 16384 };
+	static char content[CONTENT_MAX], revisions[4][CONTENT_MAX];
+	size_t content_len = 0, revisions_len[LENGTH(revisions)];
+	bool consistent = true;
+	txt = vis_text_load(vis, 0, TEXT_LOAD_AUTO);
+	srand(42);
+	for (size_t i = 0; i < EDITS; i++) {
+		size_t pos = content_len ? rand() % (content_len + 1) : 0;
+		if (rand() % 3 && content_len + 8 < sizeof content) {
+			char chunk[8];
+			size_t len = 1 + rand() % (sizeof(chunk) - 1);
+			for (size_t j = 0; j < len; j++)
+				chunk[j] = "ab\n"[rand() % 3];
+			consistent &= text_insert(vis, txt, pos, chunk, len);
+			memmove(content + pos + len, content + pos, content_len - pos);
+			memcpy(content + pos, chunk, len);
+			content_len += len;
+		} else {
+			size_t len = rand() % 16;
+			if (len > content_len - pos)
+				len = content_len - pos;
+			consistent &= text_delete(txt, pos, len);
+			memmove(content + pos, content + pos + len, content_len - pos - len);
+			content_len -= len;
+		}
+		if (i % (EDITS / LENGTH(revisions)) == 0) {
+			size_t r = i / (EDITS / LENGTH(revisions));
+			memcpy(revisions[r], content, content_len);
+			revisions_len[r] = content_len;
+			text_snapshot(txt);
+		}
+		if (rand() % 5 == 0)
+			text_snapshot(txt);
+	}
+	ok(consistent && compare_content(txt, content, content_len), "Random modifications");
+
+	TextMemoryStats stats = text_memory_stats(txt);
+	ok(stats.pieces > 0 && stats.changes > 0 && stats.revisions > 0 &&
+	   stats.bytes >= stats.pieces * sizeof(Piece) + stats.changes * sizeof(TextChange) + stats.revisions * sizeof(Revision),
+	   "Memory usage of %zu edits: %zu bytes (%zu pieces, %zu changes, %zu revisions)",
+	   (size_t)EDITS, stats.bytes, stats.pieces, stats.changes, stats.revisions);
+
+	size_t lineno = 1;
+	consistent = true;
+	for (size_t pos = 0; pos <= content_len; pos++) {
+		consistent &= text_lineno_by_pos(txt, pos) == lineno;
+		if (pos == 0 || content[pos-1] == '\n')
+			consistent &= text_pos_by_lineno(txt, lineno) == pos;
+		if (pos < content_len && content[pos] == '\n')
+			lineno++;
+	}
+	consistent &= text_pos_by_lineno(txt, lineno + 1) == EPOS;
+	ok(consistent, "Line numbers in long piece chain");
+
+	Mark marks[64];
+	size_t marks_pos[LENGTH(marks)], marks_expected[LENGTH(marks)];
+	for (size_t i = 0; i < LENGTH(marks); i++) {
+		marks_expected[i] = i * content_len / LENGTH(marks);
+		marks[i] = text_mark_set(txt, marks_expected[i]);
+	}
+	marks[LENGTH(marks)-1] = EMARK;
+	marks_expected[LENGTH(marks)-1] = EPOS;
+	text_marks_get(txt, marks, marks_pos, LENGTH(marks));
+	consistent = true;
+	for (size_t i = 0; i < LENGTH(marks); i++)
+		consistent &= marks_pos[i] == marks_expected[i] && text_mark_get(txt, marks[i]) == marks_expected[i];
+	ok(consistent, "Marks in long piece chain");
+
+	size_t snapshots = 0;
+	while (text_undo(txt) != EPOS)
+		snapshots++;
+	ok(text_size(txt) == 0, "Undo random modifications");
+	size_t r = 0;
+	for (size_t i = 0; i <= snapshots; i++) {
+		if (r < LENGTH(revisions) && compare_content(txt, revisions[r], revisions_len[r]))
+			r++;
+		text_redo(txt);
+	}
+	ok(r == LENGTH(revisions), "Redo random modifications");
+	ok(compare_content(txt, content, content_len), "Redo all random modifications");
+
+	/* random batches of sorted modifications */
+	static char batched[CONTENT_MAX];
+	consistent = true;
+	for (size_t round = 0; round < 32; round++) {
+		static char data[64][8];
+		TextEdit edits[LENGTH(data)];
+		size_t count = 0;
+		for (size_t pos = rand() % 8; count < LENGTH(edits) && pos <= content_len; pos += rand() % 24) {
+			size_t del = rand() % 3 ? rand() % 8 : 0, len = rand() % 4 ? 1 + rand() % 7 : 0;
+			if (del > content_len - pos)
+				del = content_len - pos;
+			if (content_len + sizeof(data) > sizeof(batched))
+				len = 0;
+			for (size_t j = 0; j < len; j++)
+				data[count][j] = "cd\n"[rand() % 3];
+			edits[count] = (TextEdit){ .range = text_range_new(pos, pos + del), .data = data[count], .len = len };
+			count++;
+			pos += del;
+		}
+		size_t batched_len = 0, prev = 0, lines = 1;
+		for (size_t i = 0; i < count; i++) {
+			memcpy(batched + batched_len, content + prev, edits[i].range.start - prev);
+			batched_len += edits[i].range.start - prev;
+			memcpy(batched + batched_len, edits[i].data, edits[i].len);
+			batched_len += edits[i].len;
+			prev = edits[i].range.end;
+		}
+		memcpy(batched + batched_len, content + prev, content_len - prev);
+		batched_len += content_len - prev;
+		for (size_t i = 0; i < batched_len; i++)
+			lines += batched[i] == '\n';
+
+		consistent &= text_edit_batch(vis, txt, edits, count);
+		consistent &= compare_content(txt, batched, batched_len);
+		consistent &= text_lineno_by_pos(txt, batched_len) == lines;
+		text_snapshot(txt);
+		text_undo(txt);
+		consistent &= compare_content(txt, content, content_len);
+		text_redo(txt);
+		consistent &= compare_content(txt, batched, batched_len);
+		memcpy(content, batched, batched_len);
+		content_len = batched_len;
+	}
+	ok(consistent, "Batched modifications");
+	ok(text_edit_batch(vis, txt, (TextEdit[]){
+		{ .range = text_range_new(4, 8) },
+		{ .range = text_range_new(6, 6), .data = "x", .len = 1 },
+	}, 2) == false && compare_content(txt, content, content_len), "Batched modifications out of order");
+
+	int fds[2];
+	const char *piped = "input\nread\ninto blocks";
+	TextInput input = {0};
+	bool stored = pipe(fds) == 0 && write(fds[1], piped, strlen(piped)) == (ssize_t)strlen(piped);
+	close(fds[1]);
+	for (ssize_t len; stored && (len = text_input_read(vis, txt, &input, fds[0])) != 0; )
+		stored &= len > 0;
+	close(fds[0]);
+	memmove(content + strlen(piped), content + 8, content_len - 8);
+	memcpy(content, piped, strlen(piped));
+	content_len += strlen(piped) - 8;
+	ok(stored && input.len == strlen(piped) &&
+	   text_edit_batch(vis, txt, &(TextEdit){ .range = text_range_new(0, 8), .input = &input }, 1) &&
+	   compare_content(txt, content, content_len), "Batched modification from input");
+	text_input_release(&input);
+
+	Block *last = txt->data[txt->count - 1];
+	size_t blocks = txt->count, used = last->len;
+	ok(text_input_append(vis, txt, &input, "discarded", 9) && input.len == 9, "Appending input");
+	text_input_discard(txt, &input);
+	ok(txt->count == blocks && last->len == used && compare_content(txt, content, content_len),
+	   "Discarding input");
+
+	bool chunked = true;
+	for (size_t i = 0; i < 64; i++) {
+		size_t start = rand() % (content_len + 1), end = start + rand() % (content_len - start + 1), len = 0;
+		str8 chunk;
+		for (TextChunks c = text_chunks_get(txt, text_range_new(start, end)); text_chunks_next(&c, &chunk); len += chunk.length)
+			chunked &= chunk.length > 0 && memcmp(chunk.data, content + start + len, chunk.length) == 0;
+		chunked &= len == end - start;
+	}
+	ok(chunked, "Chunks of random ranges");
+
+	text_free(txt);
+
+	txt = vis_text_load(vis, NULL, TEXT_LOAD_AUTO);
+	for (int i = 99; i >= 0; i--) {
+		char line[16];
+		snprintf(line, sizeof line, "line %02d\n", i);
+		insert(txt, 0, line);
+	}
+	char longline[64];
+	memset(longline, 'x', 40);
+	strcpy(longline + 40, "y\n");
+	insert(txt, 50*8, longline);
+	size_t size = text_size(txt);
+
+	RegexMatch match[3];
+	Regex *regex = text_regex_new();
+	int cflags = REG_EXTENDED|REG_NEWLINE;
+	ok(regex && text_regex_compile(regex, "^line 4[27]$", cflags) == 0, "Regex compile");
+	ok(!text_search_range_forward(txt, 0, size, regex, 1, match, 0) &&
+	   match[0].start == 42*8 && match[0].end == 42*8+7, "Regex forward search across windows");
+	ok(!text_search_range_forward(txt, 42*8+1, size-42*8-1, regex, 1, match, REG_NOTBOL) &&
+	   match[0].start == 47*8, "Regex forward search from within a line");
+	ok(!text_search_range_backward(txt, 0, size, regex, 1, match, 0) &&
+	   match[0].start == 47*8 && match[0].end == 47*8+7, "Regex backward search across windows");
+	ok(!text_search_range_backward(txt, 0, 47*8, regex, 1, match, 0) &&
+	   match[0].start == 42*8, "Regex backward search in partial range");
+	ok(text_regex_compile(regex, "line (9)(9)", cflags) == 0 &&
+	   !text_search_range_forward(txt, 0, size, regex, 3, match, 0) &&
+	   match[1].start == size-3 && match[2].start == size-2, "Regex sub expressions in last window");
+	ok(text_regex_compile(regex, "x+y", cflags) == 0 &&
+	   !text_search_range_forward(txt, 0, size, regex, 1, match, 0) &&
+	   match[0].start == 50*8 && match[0].end == 50*8+41, "Regex match in line longer than window");
+	ok(text_regex_compile(regex, "07\nline 08", cflags) == 0 &&
+	   !text_search_range_backward(txt, 0, size, regex, 1, match, 0) &&
+	   match[0].start == 7*8+5, "Regex match spanning lines");
+	bool spanning = true;
+	for (int i = 20; i < 30; i++) {
+		char pattern[64];
+		snprintf(pattern, sizeof pattern, i % 2 ? "%02d[[:space:]]line" : "%02d\\sline", i);
+		spanning &= text_regex_compile(regex, pattern, cflags) == 0 &&
+		            !text_search_range_forward(txt, 0, size, regex, 1, match, 0) &&
+		            match[0].start == (size_t)i*8+5 &&
+		            !text_search_range_backward(txt, 0, size, regex, 1, match, 0) &&
+		            match[0].start == (size_t)i*8+5;
+	}
+	ok(spanning, "Regex character class matching new line");
+	ok(text_regex_compile(regex, "line 100", cflags) == 0 &&
+	   text_search_range_forward(txt, 0, size, regex, 1, match, 0) == REG_NOMATCH &&
+	   text_search_range_backward(txt, 0, size, regex, 1, match, 0) == REG_NOMATCH, "Regex without match");
+	ok(text_regex_compile(regex, "[0-9]5$", cflags) == 0, "Regex compile for cursor");
+	RegexCursor cursor = text_regex_cursor(txt, regex, text_range_new(0, size));
+	size_t matches = 0;
+	consistent = true;
+	for (size_t pos = 0; !text_regex_cursor_next(&cursor, pos, 1, match, REG_NOTBOL); pos = match[0].end) {
+		size_t line = matches * 10 + 5, start = line * 8 + 5 + (line >= 50 ? 42 : 0);
+		consistent &= match[0].start == start && match[0].end == start + 2;
+		matches++;
+	}
+	ok(consistent && matches == 10, "Regex cursor yields all matches");
+	cursor = text_regex_cursor(txt, regex, text_range_new(0, 30*8));
+	ok(!text_regex_cursor_next(&cursor, 0, 1, match, 0) && match[0].start == 5*8+5 &&
+	   !text_regex_cursor_next(&cursor, match[0].end, 1, match, 0) && match[0].start == 15*8+5 &&
+	   !text_regex_cursor_next(&cursor, 15*8+6, 1, match, 0) && match[0].start == 25*8+5 &&
+	   text_regex_cursor_next(&cursor, match[0].end, 1, match, 0) == REG_NOMATCH, "Regex cursor confined to range");
+	text_regex_free(regex);
+	text_free(txt);
+
 	return exit_status();
 }
@@ -37,25 +37,17 @@ bool text_byte_get(const Text *txt, size_t pos, char *byte) {
 }
 
 size_t text_bytes_get(const Text *txt, size_t pos, size_t len, char *buf) {
-	if (!buf)
+	size_t size = text_size(txt);
+	if (!buf || pos > size)
 		return 0;
 	char *cur = buf;
-	size_t rem = len;
-	for (Iterator it = text_iterator_get(txt, pos);
-	     text_iterator_valid(&it);
-	     text_iterator_next(&it)) {
-		if (rem == 0)
-			break;
-		size_t piece_len = it.end - it.text;
-		if (piece_len > rem)
-			piece_len = rem;
-		if (piece_len) {
-			memcpy(cur, it.text, piece_len);
-			cur += piece_len;
-			rem -= piece_len;
-		}
+	str8 chunk;
+	Filerange range = text_range_new(pos, pos + MIN(len, size - pos));
+	for (TextChunks c = text_chunks_get(txt, range); text_chunks_next(&c, &chunk); ) {
+		memcpy(cur, chunk.data, chunk.length);
+		cur += chunk.length;
 	}
-	return len - rem;
+	return cur - buf;
 }
 
 char *text_bytes_alloc0(const Text *txt, size_t pos, size_t len) {
@@ -68,3 +60,22 @@ char *text_bytes_alloc0(const Text *txt, size_t pos, size_t len) {
 	buf[len] = '\0';
 	return buf;
 }
+
+TextChunks text_chunks_get(const Text *txt, Filerange range) {
+	TextChunks c = {.rem = text_range_size(range)};
+	text_iterator_init(txt, &c.it, range.start);
+	return c;
+}
+
+bool text_chunks_next(TextChunks *c, str8 *chunk) {
+	while (c->rem > 0 && text_iterator_valid(&c->it)) {
+		size_t len = MIN((size_t)(c->it.end - c->it.text), c->rem);
+		*chunk = (str8){.data = (u8 *)c->it.text, .length = len};
+		text_iterator_next(&c->it);
+		if (len > 0) {
+			c->rem -= len;
+			return true;
+		}
+	}
+	return false;
+}
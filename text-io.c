@@ -2,6 +2,10 @@
 #ifndef BLOCK_SIZE
 #define BLOCK_SIZE (1 << 20)
 #endif
+/* Loaded file content is referenced by pieces of at most this size: */
+#ifndef BLOCK_CHUNK_SIZE
+#define BLOCK_CHUNK_SIZE (1 << 16)
+#endif
 /* Files smaller than this value are copied on load, larger ones are mmap(2)-ed
  * directly. Hence the former can be truncated, while doing so on the latter
  * results in havoc. */
@@ -20,6 +24,7 @@ static Block *block_alloc(size_t size)
 		return NULL;
 	}
 	blk->type = BLOCK_TYPE_MALLOC;
+	blk->fd = -1;
 	blk->size = size;
 	return blk;
 }
@@ -28,10 +33,13 @@ static void block_free(Block *blk)
 {
 	if (!blk)
 		return;
+	if (blk->type == BLOCK_TYPE_MMAP_ORIG && blk->fd != -1)
+		close(blk->fd);
 	if (blk->type == BLOCK_TYPE_MALLOC)
 		free(blk->data);
 	else if ((blk->type == BLOCK_TYPE_MMAP_ORIG || blk->type == BLOCK_TYPE_MMAP) && blk->data)
 		munmap(blk->data, blk->size);
+	free(blk->pinned);
 	free(blk);
 }
 
@@ -71,6 +79,7 @@ static Block *block_mmap(size_t size, int fd, off_t offset)
 		}
 	}
 	blk->type = BLOCK_TYPE_MMAP_ORIG;
+	blk->fd = -1;
 	blk->size = size;
 	blk->len = size;
 	return blk;
@@ -93,10 +102,17 @@ static Block *block_load(int dirfd, const char *filename, VisTextLoadMethod meth
 	size_t size = info->st_size;
 	if (size == 0)
 		goto out;
-	if (method == TEXT_LOAD_READ || (method == TEXT_LOAD_AUTO && size < BLOCK_MMAP_SIZE))
+	if (method == TEXT_LOAD_READ || (method == TEXT_LOAD_AUTO && size < BLOCK_MMAP_SIZE)) {
 		block = block_read(size, fd);
-	else
-		block = block_mmap(size, fd, 0);
+	} else if ((block = block_mmap(size, fd, 0))) {
+		block->dev = info->st_dev;
+		block->ino = info->st_ino;
+		if (fcntl(fd, F_SETFD, FD_CLOEXEC) != -1) {
+			/* kept open to splice(2) the unmodified content, see text_pipe_range */
+			block->fd = fd;
+			fd = -1;
+		}
+	}
 out:
 	if (fd != -1)
 		close(fd);
@@ -357,72 +373,129 @@ static bool text_save_commit_atomic(TextSave *ctx) {
 	if (close(dir) == -1)
 		return false;
 
-	text_saved(ctx->txt, &meta);
+	ctx->meta = meta;
+	return true;
+}
+
+static bool block_pinned(const Block *blk, size_t page)
+{
+	return blk->pinned && (blk->pinned[page / 8] & (1 << page % 8));
+}
+
+static ssize_t pwrite_all(int fd, const char *buf, size_t count, off_t offset) {
+	size_t rem = count;
+	while (rem > 0) {
+		ssize_t written = pwrite(fd, buf, rem > INT_MAX ? INT_MAX : rem, offset);
+		if (written < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return -1;
+		} else if (written == 0) {
+			break;
+		}
+		rem -= written;
+		buf += written;
+		offset += written;
+	}
+	return count - rem;
+}
+
+/* The file region [start, end) which backs the mmap-ed block is about to be
+ * overwritten. Copy the affected pages to a temporary file at the same offset
+ * and remap them at their current position such that all pointers from the
+ * various pieces (including those of older revisions) remain valid. Pages
+ * pinned by an earlier save no longer reference the file and are left as is.
+ */
+static bool block_pin(TextSave *ctx, Block *blk, size_t start, size_t end)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t pages = (blk->size + page - 1) / page;
+	if (end > blk->size)
+		end = blk->size;
+	if (start >= end)
+		return true;
+	if (!blk->pinned && !(blk->pinned = calloc((pages + 7) / 8, 1)))
+		return false;
+	if (ctx->pinfd == -1) {
+		char tmpname[32] = "/tmp/vis-XXXXXX";
+		if ((ctx->pinfd = mkstemp(tmpname)) == -1)
+			return false;
+		if (unlink(tmpname) == -1)
+			return false;
+	}
+	for (size_t first = start / page, last = (end - 1) / page; first <= last; ) {
+		if (block_pinned(blk, first)) {
+			first++;
+			continue;
+		}
+		size_t count = 1;
+		while (first + count <= last && !block_pinned(blk, first + count))
+			count++;
+		size_t off = first * page, len = MIN(count * page, blk->size - off);
+		ssize_t written = pwrite_all(ctx->pinfd, blk->data + off, len, off);
+		if (written == -1 || (size_t)written != len)
+			return false;
+		if (mmap(blk->data + off, len, PROT_READ, MAP_SHARED|MAP_FIXED, ctx->pinfd, off) == MAP_FAILED)
+			return false;
+		for (size_t p = first; p < first + count; p++)
+			blk->pinned[p / 8] |= 1 << p % 8;
+		first += count;
+	}
 	return true;
 }
 
 static bool text_save_begin_inplace(TextSave *ctx) {
 	Text *txt = ctx->txt;
 	struct stat now = { 0 };
-	int newfd = -1, saved_errno;
 	if ((ctx->fd = openat(ctx->dirfd, (char *)ctx->filepath.data, O_CREAT|O_WRONLY, 0666)) == -1)
-		goto err;
+		return false;
 	if (fstat(ctx->fd, &now) == -1)
-		goto err;
-	struct stat loaded = text_stat(txt);
+		return false;
 	Block *block = text_block_mmaped(txt);
-	if (block && now.st_dev == loaded.st_dev && now.st_ino == loaded.st_ino) {
+	if (block && now.st_dev == block->dev && now.st_ino == block->ino) {
 		/* The file we are going to overwrite is currently mmap-ed from
-		 * text_load, therefore we copy the mmap-ed block to a temporary
-		 * file and remap it at the same position such that all pointers
-		 * from the various pieces are still valid.
-		 */
-		size_t size = block->size;
-		char tmpname[32] = "/tmp/vis-XXXXXX";
-		newfd = mkstemp(tmpname);
-		if (newfd == -1)
-			goto err;
-		if (unlink(tmpname) == -1)
-			goto err;
-		ssize_t written = write_all(newfd, block->data, size);
-		if (written == -1 || (size_t)written != size)
-			goto err;
-		void *data = mmap(block->data, size, PROT_READ, MAP_SHARED|MAP_FIXED, newfd, 0);
-		if (data == MAP_FAILED)
-			goto err;
-		bool close_failed = (close(newfd) == -1);
-		newfd = -1;
-		if (close_failed)
-			goto err;
-		block->type = BLOCK_TYPE_MMAP;
+		 * text_load, rather than a file which replaced it since, e.g. by
+		 * an atomic save. Instead of truncating it, only the parts which no
+		 * longer match the text are written, see text_rewrite_range.
+		 * Whatever they overwrite is pinned beforehand. */
+		ctx->rewrite = true;
+		ctx->offset = 0;
+		/* splicing would pass on the new file content */
+		if (block->fd != -1)
+			close(block->fd);
+		block->fd = -1;
+		return true;
 	}
 	/* overwrite the existing file content, if something goes wrong
 	 * here we are screwed, TODO: make a backup before? */
-	if (ftruncate(ctx->fd, 0) == -1)
-		goto err;
-	return true;
-err:
-	saved_errno = errno;
-	if (newfd != -1)
-		close(newfd);
-	errno = saved_errno;
-	return false;
+	return ftruncate(ctx->fd, 0) == 0;
 }
 
 static bool text_save_commit_inplace(TextSave *ctx) {
+	if (ctx->rewrite) {
+		Block *block = text_block_mmaped(ctx->txt);
+		if (block && !block_pin(ctx, block, ctx->offset, block->size))
+			return false;
+		if (ftruncate(ctx->fd, ctx->offset) == -1)
+			return false;
+	}
 	if (fsync(ctx->fd) == -1)
 		return false;
 	struct stat meta = { 0 };
 	if (fstat(ctx->fd, &meta) == -1)
 		return false;
-	if (close(ctx->fd) == -1)
+	bool close_failed = (close(ctx->fd) == -1);
+	ctx->fd = -1;
+	if (close_failed)
 		return false;
-	text_saved(ctx->txt, &meta);
+	ctx->meta = meta;
 	return true;
 }
 
 bool text_save_begin(TextSave *ctx) {
 	enum TextSaveMethod type = ctx->method;
+	text_snapshot(ctx->txt);
+	ctx->revision = ctx->txt->history;
 	errno = 0;
 	if ((type == TEXT_SAVE_AUTO || type == TEXT_SAVE_ATOMIC) && text_save_begin_atomic(ctx)) {
 		ctx->method = TEXT_SAVE_ATOMIC;
@@ -443,9 +516,13 @@ void text_save_cancel(TextSave *ctx) {
 	int saved_errno = errno;
 	if (ctx->fd != -1)
 		close(ctx->fd);
+	if (ctx->pinfd != -1)
+		close(ctx->pinfd);
 	if (ctx->tmpname.data && ctx->tmpname.data[0])
 		unlinkat(ctx->dirfd, (char *)ctx->tmpname.data, 0);
 	free(ctx->tmpname.data);
+	free(ctx->snapshot.data);
+	free(ctx->copy);
 	errno = saved_errno;
 }
 
@@ -456,31 +533,221 @@ bool text_save_commit(TextSave *ctx) {
 	case TEXT_SAVE_INPLACE: result = text_save_commit_inplace(ctx); break;
 	default: break;
 	}
+	if (result)
+		text_saved(ctx->txt, &ctx->meta);
 	text_save_cancel(ctx);
 	return result;
 }
 
 void text_mark_current_revision(Text *txt) { text_saved(txt, 0); }
 
+void text_mark_saved(TextSave *ctx) {
+	ctx->txt->info = ctx->meta;
+	ctx->txt->saved_revision = ctx->revision;
+}
+
+/* write range to the mmap-ed file the text was loaded from, parts of the
+ * original content which are still at the same offset are skipped */
+static ssize_t text_rewrite_range(TextSave *ctx, Block *blk, Filerange range)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t size = text_range_size(range), rem = size;
+	for (Iterator it = text_iterator_get(ctx->txt, range.start);
+	     rem > 0 && text_iterator_valid(&it);
+	     text_iterator_next(&it)) {
+		size_t off = ctx->offset, len = MIN((size_t)(it.end - it.text), rem);
+		if (blk->data <= it.text && it.text < blk->data + blk->size && (size_t)(it.text - blk->data) == off) {
+			/* in place, unless pinned by an earlier save which overwrote the file */
+			for (size_t pos = off, end = off + len; pos < end; ) {
+				bool pinned = block_pinned(blk, pos / page);
+				size_t next = pos;
+				while (next < end && block_pinned(blk, next / page) == pinned)
+					next = MIN((next / page + 1) * page, end);
+				if (pinned) {
+					ssize_t written = pwrite_all(ctx->fd, blk->data + pos, next - pos, pos);
+					if (written == -1 || (size_t)written != next - pos)
+						return -1;
+				}
+				pos = next;
+			}
+		} else {
+			if (!block_pin(ctx, blk, off, off + len))
+				return -1;
+			ssize_t written = pwrite_all(ctx->fd, it.text, len, off);
+			if (written == -1 || (size_t)written != len)
+				return -1;
+		}
+		ctx->offset += len;
+		rem -= len;
+	}
+	return size - rem;
+}
+
 ssize_t text_save_write_range(TextSave *ctx, Filerange range)
 {
+	Block *block = ctx->rewrite ? text_block_mmaped(ctx->txt) : NULL;
+	if (block)
+		return text_rewrite_range(ctx, block, range);
 	return text_write_range(ctx->txt, range, ctx->fd);
 }
 
+#if defined(__linux__) && defined(SYS_copy_file_range)
+/* write len bytes at data to fd, unmodified file content is copied (or
+ * reflinked) by the kernel without passing through user space */
+static ssize_t file_copy(const Block *orig, int fd, const char *data, size_t len)
+{
+	size_t rem = len;
+	if (orig && orig->fd != -1 && orig->data <= data && data + len <= orig->data + orig->len) {
+		int64_t offset = data - orig->data; /* loff_t */
+		ssize_t copied = 0;
+		while (rem > 0) {
+			copied = syscall(SYS_copy_file_range, orig->fd, &offset, fd, NULL, rem, 0);
+			if (copied == -1 && errno == EINTR)
+				continue;
+			if (copied <= 0)
+				break;
+			rem -= copied;
+		}
+		/* not a regular file, across file systems (before Linux 5.3) or not
+		 * supported at all, write the remaining data instead */
+		if (copied == -1 && errno != EXDEV && errno != EINVAL && errno != ENOSYS &&
+		    errno != EOPNOTSUPP && errno != EBADF)
+			return -1;
+	}
+	ssize_t written = write_all(fd, data + len - rem, rem);
+	if (written == -1)
+		return -1;
+	return len - rem + written;
+}
+#else
+#define file_copy(orig, fd, data, len) ((void)(orig), write_all(fd, data, len))
+#endif
+
 ssize_t text_write_range(const Text *txt, Filerange range, int fd)
+{
+	size_t size = text_range_size(range), rem = size, done = 0;
+	const Block *orig = text_block_mmaped((Text *)txt);
+	Iterator it = text_iterator_get(txt, range.start);
+	while (rem > 0) {
+		/* coalesce pieces adjacent in memory, e.g. unmodified file content */
+		const char *data = it.text;
+		size_t len = 0;
+		while (rem > 0 && text_iterator_valid(&it) && it.text == data + len) {
+			size_t prem = MIN((size_t)(it.end - it.text), rem);
+			len += prem;
+			rem -= prem;
+			text_iterator_next(&it);
+		}
+		if (len == 0)
+			break;
+		ssize_t written = file_copy(orig, fd, data, len);
+		if (written == -1)
+			return -1;
+		done += written;
+		if ((size_t)written != len)
+			break;
+	}
+	return done;
+}
+
+bool text_save_snapshot(TextSave *ctx, const Filerange *ranges, size_t count)
+{
+	size_t chunks = 0, copy = 0;
+	str8 chunk;
+	for (size_t i = 0; i < count; i++) {
+		for (TextChunks c = text_chunks_get(ctx->txt, ranges[i]); text_chunks_next(&c, &chunk); chunks++) {
+			if (!text_chunk_stable(ctx->txt, chunk))
+				copy += chunk.length;
+		}
+	}
+	str8 *data = malloc(MAX(chunks, 1) * sizeof *data);
+	char *buf = copy > 0 ? malloc(copy) : NULL;
+	if (!data || (copy > 0 && !buf)) {
+		free(data);
+		free(buf);
+		return false;
+	}
+	ctx->snapshot = (str8_list){.data = data, .capacity = chunks};
+	ctx->copy = buf;
+	ctx->orig = text_block_mmaped(ctx->txt);
+	for (size_t i = 0; i < count; i++) {
+		for (TextChunks c = text_chunks_get(ctx->txt, ranges[i]); text_chunks_next(&c, &chunk); ) {
+			if (!text_chunk_stable(ctx->txt, chunk)) {
+				memcpy(buf, chunk.data, chunk.length);
+				chunk.data = (u8 *)buf;
+				buf += chunk.length;
+			}
+			/* coalesce slices adjacent in memory, e.g. unmodified file content */
+			str8 *last = ctx->snapshot.count > 0 ? data + ctx->snapshot.count - 1 : NULL;
+			if (last && last->data + last->length == chunk.data)
+				last->length += chunk.length;
+			else
+				data[ctx->snapshot.count++] = chunk;
+		}
+	}
+	return true;
+}
+
+bool text_save_commit_snapshot(TextSave *ctx)
+{
+	bool result = ctx->method == TEXT_SAVE_ATOMIC;
+	for (VisDACount i = 0; result && i < ctx->snapshot.count; i++) {
+		str8 chunk = ctx->snapshot.data[i];
+		ssize_t written = file_copy(ctx->orig, ctx->fd, (const char *)chunk.data, chunk.length);
+		result = written != -1 && written == chunk.length;
+	}
+	result = result && text_save_commit_atomic(ctx);
+	text_save_cancel(ctx);
+	return result;
+}
+
+#if defined(__linux__)
+/* move len bytes at data into the pipe fd, without copying them if possible */
+static ssize_t pipe_move(const Text *txt, const Block *orig, int fd, unsigned flags,
+                         const char *data, size_t len)
+{
+	ssize_t written = -1;
+	if (orig && orig->fd != -1 && orig->data <= data && data < orig->data + orig->len) {
+		/* unmodified file content, pass it on directly from the page cache */
+		int64_t offset = data - orig->data; /* loff_t */
+		written = syscall(SYS_splice, orig->fd, &offset, fd, NULL, len, SPLICE_F_MOVE|flags);
+	} else if (!text_chunk_stable(txt, (str8){.data = (u8 *)data, .length = len})) {
+		/* might change before it is read, hand over a copy */
+		return write(fd, data, len);
+	} else {
+		/* the pipe references the pages, the data must stay unchanged until it was read */
+		struct iovec iov = {.iov_base = (void *)data, .iov_len = len};
+		written = syscall(SYS_vmsplice, fd, &iov, 1, flags);
+	}
+	/* not a pipe or not supported by the file system */
+	if (written == -1 && (errno == EINVAL || errno == ENOSYS || errno == EBADF))
+		written = write(fd, data, len);
+	return written;
+}
+#endif
+
+ssize_t text_pipe_range(const Text *txt, Filerange range, int fd)
 {
 	size_t size = text_range_size(range), rem = size;
+#if defined(__linux__)
+	const Block *orig = text_block_mmaped((Text *)txt);
+	/* vmsplice(2) ignores O_NONBLOCK of the pipe, it has to be requested */
+	int fl = fcntl(fd, F_GETFL);
+	unsigned flags = fl != -1 && (fl & O_NONBLOCK) ? SPLICE_F_NONBLOCK : 0;
+#endif
 	for (Iterator it = text_iterator_get(txt, range.start);
 	     rem > 0 && text_iterator_valid(&it);
 	     text_iterator_next(&it)) {
-		size_t prem = it.end - it.text;
-		if (prem > rem)
-			prem = rem;
-		ssize_t written = write_all(fd, it.text, prem);
+		size_t len = MIN((size_t)(it.end - it.text), rem);
+#if defined(__linux__)
+		ssize_t written = pipe_move(txt, orig, fd, flags, it.text, len);
+#else
+		ssize_t written = write(fd, it.text, len);
+#endif
 		if (written == -1)
-			return -1;
+			return rem == size ? -1 : (ssize_t)(size - rem);
 		rem -= written;
-		if ((size_t)written != prem)
+		if ((size_t)written != len)
 			break;
 	}
 	return size - rem;
@@ -139,6 +139,17 @@ int text_search_range_forward(Text *txt, size_t pos, size_t len, Regex *r, size_
 	return ret;
 }
 
+RegexCursor text_regex_cursor(Text *txt, Regex *r, Filerange range) {
+	return (RegexCursor){ .txt = txt, .regex = r, .range = range };
+}
+
+int text_regex_cursor_next(RegexCursor *c, size_t pos, size_t nmatch, RegexMatch pmatch[], int eflags) {
+	/* matching is driven by an iterator, nothing needs to be buffered */
+	if (pos > c->range.end)
+		return REG_NOMATCH;
+	return text_search_range_forward(c->txt, pos, c->range.end - pos, c->regex, nmatch, pmatch, eflags);
+}
+
 int text_search_range_backward(Text *txt, size_t pos, size_t len, Regex *r, size_t nmatch, RegexMatch pmatch[], int eflags) {
 	int ret = REG_NOMATCH;
 	size_t end = pos + len;
@@ -1,5 +1,13 @@
+#ifndef REGEX_WINDOW_SIZE
+#define REGEX_WINDOW_SIZE (1 << 20)
+#endif
+
 struct Regex {
 	regex_t regex;
+	bool multiline; /* matches may span new lines, search whole range at once */
+	char *buf;      /* NUL terminated copy of the current search window */
+	size_t size;    /* allocated size of buf */
+	Filerange window; /* text range currently held in buf */
 };
 
 Regex *text_regex_new(void) {
@@ -10,10 +18,24 @@ Regex *text_regex_new(void) {
 	return r;
 }
 
+/* Whether a pattern compiled with REG_NEWLINE might match a new line. The
+ * match-any operator and non-matching lists don't, but a literal new line,
+ * character classes such as [[:space:]] (also collating elements and
+ * equivalence classes) and the \s and \W escapes of glibc do. */
+static bool regex_newline(const char *string) {
+	static const char *const newline[] = { "\n", "[:", "[=", "[.", "\\s", "\\W" };
+	for (size_t i = 0; i < LENGTH(newline); i++) {
+		if (strstr(string, newline[i]))
+			return true;
+	}
+	return false;
+}
+
 int text_regex_compile(Regex *regex, const char *string, int cflags) {
 	int r = regcomp(&regex->regex, string, cflags);
 	if (r)
 		regcomp(&regex->regex, "\0\0", 0);
+	regex->multiline = !r && (!(cflags & REG_NEWLINE) || regex_newline(string));
 	return r;
 }
 
@@ -27,6 +49,7 @@ void text_regex_free(Regex *r) {
 	if (!r)
 		return;
 	regfree(&r->regex);
+	free(r->buf);
 	free(r);
 }
 
@@ -34,10 +57,40 @@ int text_regex_match(Regex *r, const char *data, int eflags) {
 	return regexec(&r->regex, data, 0, NULL, eflags);
 }
 
-int text_search_range_forward(Text *txt, size_t pos, size_t len, Regex *r, size_t nmatch, RegexMatch pmatch[], int eflags) {
-	char *buf = text_bytes_alloc0(txt, pos, len);
-	if (!buf)
-		return REG_NOMATCH;
+/* Searches are performed in windows of whole lines of roughly REGEX_WINDOW_SIZE
+ * bytes, hence memory usage does not depend on the size of the search range.
+ * Unless the pattern can match a new line, no match can cross a window boundary. */
+static size_t regex_window_end(Regex *r, Text *txt, size_t pos, size_t end) {
+	if (r->multiline || end - pos <= REGEX_WINDOW_SIZE)
+		return end;
+	size_t next = text_line_next(txt, pos + REGEX_WINDOW_SIZE - 1);
+	return pos < next && next < end ? next : end;
+}
+
+static size_t regex_window_begin(Regex *r, Text *txt, size_t start, size_t pos) {
+	if (r->multiline || pos - start <= REGEX_WINDOW_SIZE)
+		return start;
+	size_t begin = text_line_begin(txt, pos - REGEX_WINDOW_SIZE);
+	return start < begin ? begin : start;
+}
+
+static char *regex_window(Regex *r, Text *txt, size_t pos, size_t len) {
+	if (len >= r->size) {
+		char *buf = realloc(r->buf, len+1);
+		if (!buf) {
+			r->window = text_range_empty();
+			return NULL;
+		}
+		r->buf = buf;
+		r->size = len+1;
+	}
+	len = text_bytes_get(txt, pos, len, r->buf);
+	r->buf[len] = '\0';
+	r->window = text_range_new(pos, pos + len);
+	return r->buf;
+}
+
+static int regex_window_forward(Regex *r, char *buf, size_t pos, size_t len, size_t nmatch, RegexMatch pmatch[], int eflags) {
 	char *cur = buf, *end = buf + len;
 	int ret = REG_NOMATCH;
 	regmatch_t match[MAX_REGEX_SUB];
@@ -58,14 +111,10 @@ int text_search_range_forward(Text *txt, size_t pos, size_t len, Regex *r, size_
 		junk = next - cur;
 		cur = next;
 	}
-	free(buf);
 	return ret;
 }
 
-int text_search_range_backward(Text *txt, size_t pos, size_t len, Regex *r, size_t nmatch, RegexMatch pmatch[], int eflags) {
-	char *buf = text_bytes_alloc0(txt, pos, len);
-	if (!buf)
-		return REG_NOMATCH;
+static int regex_window_backward(Regex *r, char *buf, size_t pos, size_t len, size_t nmatch, RegexMatch pmatch[], int eflags) {
 	char *cur = buf, *end = buf + len;
 	int ret = REG_NOMATCH;
 	regmatch_t match[MAX_REGEX_SUB];
@@ -101,6 +150,53 @@ int text_search_range_backward(Text *txt, size_t pos, size_t len, Regex *r, size
 		else
 			eflags |= REG_NOTBOL;
 	}
-	free(buf);
+	return ret;
+}
+
+RegexCursor text_regex_cursor(Text *txt, Regex *r, Filerange range) {
+	r->window = text_range_empty();
+	return (RegexCursor){ .txt = txt, .regex = r, .range = range };
+}
+
+int text_regex_cursor_next(RegexCursor *c, size_t pos, size_t nmatch, RegexMatch pmatch[], int eflags) {
+	Regex *r = c->regex;
+	size_t end = c->range.end;
+	int ret = REG_NOMATCH;
+	while (ret && pos < end) {
+		/* reuse the window of a previous search if it covers pos */
+		if (!(r->window.start <= pos && pos < r->window.end)) {
+			size_t next = regex_window_end(r, c->txt, pos, end);
+			if (!regex_window(r, c->txt, pos, next - pos) || r->window.end <= pos)
+				break;
+		}
+		size_t next = r->window.end;
+		char *buf = r->buf + (pos - r->window.start);
+		/* windows other than the last one end after a new line */
+		int flags = next < end ? eflags|REG_NOTEOL : eflags;
+		ret = regex_window_forward(r, buf, pos, next - pos, nmatch, pmatch, flags);
+		eflags &= ~REG_NOTBOL;
+		pos = next;
+	}
+	return ret;
+}
+
+int text_search_range_forward(Text *txt, size_t pos, size_t len, Regex *r, size_t nmatch, RegexMatch pmatch[], int eflags) {
+	RegexCursor c = text_regex_cursor(txt, r, text_range_new(pos, pos + len));
+	return text_regex_cursor_next(&c, pos, nmatch, pmatch, eflags);
+}
+
+int text_search_range_backward(Text *txt, size_t pos, size_t len, Regex *r, size_t nmatch, RegexMatch pmatch[], int eflags) {
+	int ret = REG_NOMATCH;
+	for (size_t end = pos + len, last = end, begin; ret && pos < end; end = begin) {
+		begin = regex_window_begin(r, txt, pos, end);
+		char *buf = regex_window(r, txt, begin, end - begin);
+		if (!buf)
+			break;
+		/* windows other than the first one start at the beginning of a line */
+		int flags = begin > pos ? eflags & ~REG_NOTBOL : eflags;
+		if (end < last)
+			flags |= REG_NOTEOL;
+		ret = regex_window_backward(r, buf, begin, end - begin, nmatch, pmatch, flags);
+	}
 	return ret;
 }
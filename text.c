@@ -12,12 +12,21 @@
 struct Piece {
 	Text *text;             /* text to which this piece belongs */
 	Piece *prev, *next;     /* pointers to the logical predecessor/successor */
-	Piece *global_prev;     /* double linked list in order of allocation, */
-	Piece *global_next;     /* used to free individual pieces */
+	Piece *parent;          /* position index, see index_insert */
+	Piece *left, *right;    /* children in the position index */
+	size_t weight;          /* the sum of the lengths of all pieces in this subtree */
+	size_t weight_lines;    /* the number of new lines in this subtree or LINES_UNKNOWN */
+	uint32_t prio;          /* random heap priority used to keep the indices balanced */
+	Piece *mark_parent;     /* mark index, see mark_index_insert */
+	Piece *mark_left, *mark_right; /* children in the mark index */
 	const char *data;       /* pointer into a Block holding the data */
 	size_t len;             /* the length in number of bytes of the data */
+	size_t lines;           /* the number of new lines in the data or LINES_UNKNOWN */
 };
 
+/* new lines of pieces are only counted once they are needed */
+#define LINES_UNKNOWN SIZE_MAX
+
 /* used to transform a global position (byte offset starting from the beginning
  * of the text) into an offset relative to a piece.
  */
@@ -58,18 +67,37 @@ struct Revision {
 	size_t seq;             /* a unique, strictly increasing identifier */
 };
 
+/* A slab of fixed size objects handed out by a Pool. */
+typedef struct PoolSlab PoolSlab;
+struct PoolSlab {
+	PoolSlab *next;         /* previously allocated slab */
+	size_t capacity;        /* number of objects which fit into this slab */
+	size_t used;            /* number of objects handed out so far */
+	alignas(16) char data[];
+};
+
+/* Allocator for objects of a given size. Objects are carved out of slabs of
+ * increasing size, released ones are kept in a free list for reuse. All
+ * slabs are freed at once when the text is destroyed. */
 typedef struct {
-	size_t pos;             /* position in bytes from start of file */
-	size_t lineno;          /* line number in file i.e. number of '\n' in [0, pos) */
-} LineCache;
+	size_t size;            /* object size in bytes */
+	PoolSlab *slabs;        /* most recently allocated slab */
+	void *free;             /* singly linked list of released objects */
+	size_t objects;         /* number of objects currently in use */
+	size_t bytes;           /* memory reserved for all slabs */
+} Pool;
 
 /* Block holding the file content, either readonly mmap(2)-ed from the original
  * file or heap allocated to store the modifications.
  */
-typedef struct {
+typedef struct Block {
 	size_t size;               /* maximal capacity */
 	size_t len;                /* current used length / insertion position */
 	char *data;                /* actual data */
+	int fd;                    /* file backing a BLOCK_TYPE_MMAP_ORIG block, -1 if unavailable */
+	dev_t dev;                 /* device and inode of the file a BLOCK_TYPE_MMAP_ORIG block maps */
+	ino_t ino;
+	uint8_t *pinned;           /* bitmap of BLOCK_TYPE_MMAP_ORIG pages remapped from a private copy */
 	enum {                     /* type of allocation */
 		BLOCK_TYPE_MMAP_ORIG, /* mmap(2)-ed from an external file */
 		BLOCK_TYPE_MMAP,      /* mmap(2)-ed from a temporary file only known to this process */
@@ -86,16 +114,21 @@ struct Text {
 	VisDACount   count;
 	VisDACount   capacity;
 
-	Piece *pieces;          /* all pieces which have been allocated, used to free them */
+	Pool pieces;            /* allocator for pieces */
+	Pool changes;           /* allocator for changes */
+	Pool revisions;         /* allocator for revisions */
 	Piece *cache;           /* most recently modified piece */
 	Piece begin, end;       /* sentinel nodes which always exists but don't hold any data */
+	Piece *root;            /* root of the position index over all pieces in the chain */
+	Piece *mark_root;       /* root of the mark index over all non-empty pieces in the chain */
+	uint32_t seed;          /* state of the priority generator for the position index */
 	Revision *history;        /* undo tree */
 	Revision *current_revision; /* revision holding all file changes until a snapshot is performed */
 	Revision *last_revision;    /* the last revision added to the tree, chronologically */
 	Revision *saved_revision;   /* the last revision at the time of the save operation */
 	size_t size;            /* current file content size in bytes */
+	size_t version;         /* incremented on every modification of the content */
 	struct stat info;       /* stat as probed at load time */
-	LineCache lines;        /* mapping between absolute pos in bytes and logical line breaks */
 };
 
 #include "text-common.c"
@@ -110,6 +143,10 @@ struct Text {
   #include "text-regex.c"
 #endif
 
+/* object allocation */
+static void *pool_alloc(Pool *pool);
+static void pool_free(Pool *pool, void *obj);
+static void pool_release(Pool *pool);
 /* cache layer */
 static void cache_piece(Text *txt, Piece *p);
 static bool cache_contains(Text *txt, Piece *p);
@@ -121,23 +158,78 @@ static void piece_free(Piece *p);
 static void piece_init(Piece *p, Piece *prev, Piece *next, const char *data, size_t len);
 static Location piece_get_intern(Text *txt, size_t pos);
 static Location piece_get_extern(const Text *txt, size_t pos);
+/* position index */
+static void index_insert(Text *txt, Piece *prev, Piece *p);
+static void index_remove(Text *txt, Piece *p);
+static void index_update_path(Piece *p);
+static size_t index_position(const Piece *p);
+/* mark index */
+static void mark_index_insert(Text *txt, Piece *p);
+static void mark_index_remove(Text *txt, Piece *p);
+static Piece *mark_index_get(const Text *txt, Mark mark);
 /* span management */
 static void span_init(Span *span, Piece *start, Piece *end);
 static void span_swap(Text *txt, Span *old, Span *new);
 /* change management */
 static TextChange *text_change_alloc(Text *txt, size_t pos);
-static void text_change_free(TextChange *c);
+static void text_change_free(Text *txt, TextChange *c);
 /* revision management */
 static Revision *revision_alloc(Text *txt);
-static void revision_free(Revision *rev);
-/* logical line counting cache */
-static void lineno_cache_invalidate(LineCache *cache);
-static size_t lines_skip_forward(Text *txt, size_t pos, size_t lines, size_t *lines_skipped);
-static size_t lines_count(Text *txt, size_t pos, size_t len);
+/* logical line counting */
+static size_t lines_count(const char *data, size_t len);
+static size_t piece_lines(Piece *p);
+static size_t piece_lines_prefix(Piece *p, size_t off);
+static size_t index_lines(Piece *p);
+
+/* Slabs start small, such that short lived texts do not waste memory, and
+ * grow up to this number of objects. */
+#define POOL_SLAB_MAX 4096
+
+/* returns a zero initialized object or NULL if allocation failed */
+static void *pool_alloc(Pool *pool) {
+	void *obj = pool->free;
+	if (obj) {
+		pool->free = *(void **)obj;
+	} else {
+		PoolSlab *slab = pool->slabs;
+		if (!slab || slab->used == slab->capacity) {
+			size_t capacity = slab ? MIN(2 * slab->capacity, POOL_SLAB_MAX) : 32;
+			size_t size = sizeof(*slab) + capacity * pool->size;
+			if (!(slab = malloc(size)))
+				return NULL;
+			slab->next = pool->slabs;
+			slab->capacity = capacity;
+			slab->used = 0;
+			pool->slabs = slab;
+			pool->bytes += size;
+		}
+		obj = slab->data + slab->used++ * pool->size;
+	}
+	pool->objects++;
+	return memset(obj, 0, pool->size);
+}
 
-/* stores the given data in a block, allocates a new one if necessary. Returns
- * a pointer to the storage location or NULL if allocation failed. */
-static const char *block_store(Vis *vis, Text *txt, const char *data, size_t len)
+static void pool_free(Pool *pool, void *obj) {
+	if (!obj)
+		return;
+	*(void **)obj = pool->free;
+	pool->free = obj;
+	pool->objects--;
+}
+
+static void pool_release(Pool *pool) {
+	for (PoolSlab *next, *slab = pool->slabs; slab; slab = next) {
+		next = slab->next;
+		free(slab);
+	}
+	pool->slabs = NULL;
+	pool->free = NULL;
+	pool->objects = 0;
+	pool->bytes = 0;
+}
+
+/* returns the most recent block if it has room for len bytes, a new one otherwise */
+static Block *block_reserve(Vis *vis, Text *txt, size_t len)
 {
 	Block *b = txt->count > 0 ? txt->data[txt->count - 1] : 0;
 	if (!b || !block_capacity(b, len)) {
@@ -146,7 +238,77 @@ static const char *block_store(Vis *vis, Text *txt, const char *data, size_t len
 			return 0;
 		*da_push(vis, txt) = b;
 	}
-	return block_append(b, data, len);
+	return b;
+}
+
+/* stores the given data in a block, allocates a new one if necessary. Returns
+ * a pointer to the storage location or NULL if allocation failed. */
+static const char *block_store(Vis *vis, Text *txt, const char *data, size_t len)
+{
+	Block *b = block_reserve(vis, txt, len);
+	return b ? block_append(b, data, len) : 0;
+}
+
+/* record len bytes just stored at data, extending the last chunk if adjacent */
+static void input_add(Vis *vis, TextInput *in, const char *data, size_t len)
+{
+	TextInputChunk *last = in->count > 0 ? in->data + in->count - 1 : 0;
+	size_t lines = lines_count(data, len);
+	if (last && last->data + last->len == data) {
+		last->len += len;
+		last->lines += lines;
+	} else {
+		*da_push(vis, in) = (TextInputChunk){.data = data, .len = len, .lines = lines};
+	}
+	in->len += len;
+}
+
+ssize_t text_input_read(Vis *vis, Text *txt, TextInput *in, int fd)
+{
+	Block *b = block_reserve(vis, txt, MIN(BUFSIZ, BLOCK_SIZE));
+	if (!b) {
+		errno = ENOMEM;
+		return -1;
+	}
+	char *data = b->data + b->len;
+	ssize_t len = read(fd, data, b->size - b->len);
+	if (len > 0) {
+		b->len += len;
+		input_add(vis, in, data, len);
+	}
+	return len;
+}
+
+bool text_input_append(Vis *vis, Text *txt, TextInput *in, const char *data, size_t len)
+{
+	if (len == 0)
+		return true;
+	const char *stored = block_store(vis, txt, data, len);
+	if (stored)
+		input_add(vis, in, stored, len);
+	return stored;
+}
+
+void text_input_release(TextInput *in)
+{
+	da_release(in);
+	*in = (TextInput){0};
+}
+
+void text_input_discard(Text *txt, TextInput *in)
+{
+	for (VisDACount i = in->count; i > 0; i--) {
+		const TextInputChunk *c = in->data + i - 1;
+		Block *b = txt->count > 0 ? txt->data[txt->count - 1] : 0;
+		if (!b || b->type != BLOCK_TYPE_MALLOC || c->data + c->len != b->data + b->len)
+			break;
+		b->len -= c->len;
+		if (b->len == 0) {
+			block_free(b);
+			txt->count--;
+		}
+	}
+	text_input_release(in);
 }
 
 /* cache the given piece if it is the most recently changed one */
@@ -178,6 +340,15 @@ static bool cache_contains(Text *txt, Piece *p)
 	return found && p->data + p->len == blk->data + blk->len;
 }
 
+bool text_chunk_stable(const Text *txt, str8 chunk)
+{
+	/* the most recently modified piece is changed in place, see cache_insert */
+	const Block *last = txt->count > 0 ? txt->data[txt->count - 1] : NULL;
+	const char *data = (const char *)chunk.data;
+	return !txt->cache || !last || data < last->data || data >= last->data + last->size ||
+	       data + chunk.length <= txt->cache->data;
+}
+
 /* try to insert a chunk of data at a given piece offset. The insertion is only
  * performed if the piece is the most recently changed one. The length of the
  * piece, the span containing it and the whole text is adjusted accordingly */
@@ -189,9 +360,15 @@ static bool cache_insert(Text *txt, Piece *p, size_t off, const char *data, size
 	size_t bufpos = p->data + off - blk->data;
 	if (!block_insert(blk, bufpos, data, len))
 		return false;
+	if (p->len == 0)
+		mark_index_insert(txt, p);
 	p->len += len;
+	if (p->lines != LINES_UNKNOWN)
+		p->lines += lines_count(data, len);
+	index_update_path(p);
 	txt->current_revision->change->new.len += len;
 	txt->size += len;
+	txt->version++;
 	return true;
 }
 
@@ -206,11 +383,20 @@ static bool cache_delete(Text *txt, Piece *p, size_t off, size_t len)
 	Block *blk = txt->data[txt->count - 1];
 	size_t end;
 	size_t bufpos = p->data + off - blk->data;
-	if (!addu(off, len, &end) || end > p->len || !block_delete(blk, bufpos, len))
+	if (!addu(off, len, &end) || end > p->len)
+		return false;
+	size_t lines = p->lines == LINES_UNKNOWN ? 0 : lines_count(p->data + off, len);
+	if (!block_delete(blk, bufpos, len))
 		return false;
 	p->len -= len;
+	if (p->lines != LINES_UNKNOWN)
+		p->lines -= lines;
+	index_update_path(p);
+	if (p->len == 0)
+		mark_index_remove(txt, p);
 	txt->current_revision->change->new.len -= len;
 	txt->size -= len;
+	txt->version++;
 	return true;
 }
 
@@ -227,12 +413,35 @@ static void span_init(Span *span, Piece *start, Piece *end) {
 	span->len = len;
 }
 
+/* add all pieces of a span to the indices, the piece preceding the span
+ * has to be part of the chain already */
+static void span_index_insert(Text *txt, Span *span) {
+	for (Piece *p = span->start; p; p = p->next) {
+		index_insert(txt, p->prev, p);
+		if (p->len > 0)
+			mark_index_insert(txt, p);
+		if (p == span->end)
+			break;
+	}
+}
+
+/* remove all pieces of a span from the indices */
+static void span_index_remove(Text *txt, Span *span) {
+	for (Piece *p = span->start; p; p = p->next) {
+		index_remove(txt, p);
+		if (p->len > 0)
+			mark_index_remove(txt, p);
+		if (p == span->end)
+			break;
+	}
+}
+
 /* swap out an old span and replace it with a new one.
  *
  *  - if old is an empty span do not remove anything, just insert the new one
  *  - if new is an empty span do not insert anything, just remove the old one
  *
- * adjusts the document size accordingly.
+ * adjusts the document size and the position index accordingly.
  */
 static void span_swap(Text *txt, Span *old, Span *new) {
 	if (old->len == 0 && new->len == 0) {
@@ -241,23 +450,28 @@ static void span_swap(Text *txt, Span *old, Span *new) {
 		/* insert new span */
 		new->start->prev->next = new->start;
 		new->end->next->prev = new->end;
+		span_index_insert(txt, new);
 	} else if (new->len == 0) {
 		/* delete old span */
 		old->start->prev->next = old->end->next;
 		old->end->next->prev = old->start->prev;
+		span_index_remove(txt, old);
 	} else {
 		/* replace old with new */
 		old->start->prev->next = new->start;
 		old->end->next->prev = new->end;
+		span_index_remove(txt, old);
+		span_index_insert(txt, new);
 	}
 	txt->size -= old->len;
 	txt->size += new->len;
+	txt->version++;
 }
 
 /* Allocate a new revision and place it in the revision graph.
  * All further changes will be associated with this revision. */
 static Revision *revision_alloc(Text *txt) {
-	Revision *rev = calloc(1, sizeof *rev);
+	Revision *rev = pool_alloc(&txt->revisions);
 	if (!rev)
 		return NULL;
 	rev->time = time(NULL);
@@ -286,40 +500,21 @@ static Revision *revision_alloc(Text *txt) {
 	return rev;
 }
 
-static void revision_free(Revision *rev) {
-	if (!rev)
-		return;
-	for (TextChange *next, *c = rev->change; c; c = next) {
-		next = c->next;
-		text_change_free(c);
-	}
-	free(rev);
-}
-
 static Piece *piece_alloc(Text *txt) {
-	Piece *p = calloc(1, sizeof *p);
+	Piece *p = pool_alloc(&txt->pieces);
 	if (!p)
 		return NULL;
 	p->text = txt;
-	p->global_next = txt->pieces;
-	if (txt->pieces)
-		txt->pieces->global_prev = p;
-	txt->pieces = p;
 	return p;
 }
 
 static void piece_free(Piece *p) {
 	if (!p)
 		return;
-	if (p->global_prev)
-		p->global_prev->global_next = p->global_next;
-	if (p->global_next)
-		p->global_next->global_prev = p->global_prev;
-	if (p->text->pieces == p)
-		p->text->pieces = p->global_next;
-	if (p->text->cache == p)
-		p->text->cache = NULL;
-	free(p);
+	Text *txt = p->text;
+	if (txt->cache == p)
+		txt->cache = NULL;
+	pool_free(&txt->pieces, p);
 }
 
 static void piece_init(Piece *p, Piece *prev, Piece *next, const char *data, size_t len) {
@@ -327,6 +522,202 @@ static void piece_init(Piece *p, Piece *prev, Piece *next, const char *data, siz
 	p->next = next;
 	p->data = data;
 	p->len = len;
+	p->lines = LINES_UNKNOWN;
+}
+
+/* The position index is a treap: a binary search tree ordered by the logical
+ * position of the pieces within the chain which, by means of randomly assigned
+ * heap priorities, is expected to stay balanced. Every node caches the total
+ * length of its subtree. This allows to map an absolute position to a piece in
+ * O(log n) instead of walking the whole chain. Only pieces which are currently
+ * linked into the chain are part of the index, the sentinels never are.
+ *
+ * Changes to the chain are always performed by span_swap, which keeps the
+ * index in sync. Pieces of swapped out spans are thus removed from the index,
+ * but keep their prev/next pointers such that undo/redo can re-insert them.
+ */
+static uint32_t index_priority(Text *txt) {
+	/* xorshift32 */
+	uint32_t x = txt->seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return txt->seed = x;
+}
+
+/* accumulate the subtree rooted at c into its parent p */
+static void index_accumulate(Piece *p, const Piece *c) {
+	if (!c)
+		return;
+	p->weight += c->weight;
+	if (p->weight_lines != LINES_UNKNOWN && c->weight_lines != LINES_UNKNOWN)
+		p->weight_lines += c->weight_lines;
+	else
+		p->weight_lines = LINES_UNKNOWN;
+}
+
+static void index_update(Piece *p) {
+	p->weight = p->len;
+	p->weight_lines = p->lines;
+	index_accumulate(p, p->left);
+	index_accumulate(p, p->right);
+}
+
+/* recalculate subtree lengths and new line counts from p up to the root */
+static void index_update_path(Piece *p) {
+	for (; p; p = p->parent)
+		index_update(p);
+}
+
+/* replace p with c as child of p's parent */
+static void index_replace(Text *txt, Piece *p, Piece *c) {
+	Piece *parent = p->parent;
+	if (!parent)
+		txt->root = c;
+	else if (parent->left == p)
+		parent->left = c;
+	else
+		parent->right = c;
+	if (c)
+		c->parent = parent;
+}
+
+/* rotate p above its parent, the in-order sequence is preserved */
+static void index_rotate_up(Text *txt, Piece *p) {
+	Piece *parent = p->parent;
+	index_replace(txt, parent, p);
+	if (parent->left == p) {
+		parent->left = p->right;
+		if (p->right)
+			p->right->parent = parent;
+		p->right = parent;
+	} else {
+		parent->right = p->left;
+		if (p->left)
+			p->left->parent = parent;
+		p->left = parent;
+	}
+	parent->parent = p;
+	index_update(parent);
+	index_update(p);
+}
+
+/* insert p into the index such that it directly follows prev, which is
+ * either part of the index or the begin sentinel */
+static void index_insert(Text *txt, Piece *prev, Piece *p) {
+	Piece *parent;
+	p->left = p->right = NULL;
+	p->prio = index_priority(txt);
+	index_update(p);
+	if (prev == &txt->begin) {
+		for (parent = txt->root; parent && parent->left; parent = parent->left);
+		if (parent)
+			parent->left = p;
+		else
+			txt->root = p;
+	} else if (!prev->right) {
+		parent = prev;
+		parent->right = p;
+	} else {
+		for (parent = prev->right; parent->left; parent = parent->left);
+		parent->left = p;
+	}
+	p->parent = parent;
+	index_update_path(parent);
+	while (p->parent && p->parent->prio < p->prio)
+		index_rotate_up(txt, p);
+}
+
+static void index_remove(Text *txt, Piece *p) {
+	while (p->left && p->right)
+		index_rotate_up(txt, p->left->prio > p->right->prio ? p->left : p->right);
+	Piece *parent = p->parent;
+	index_replace(txt, p, p->left ? p->left : p->right);
+	index_update_path(parent);
+	p->parent = p->left = p->right = NULL;
+}
+
+/* absolute position of the first byte of p */
+static size_t index_position(const Piece *p) {
+	size_t pos = p->left ? p->left->weight : 0;
+	for (; p->parent; p = p->parent) {
+		const Piece *parent = p->parent;
+		if (parent->right == p)
+			pos += parent->len + (parent->left ? parent->left->weight : 0);
+	}
+	return pos;
+}
+
+/* The mark index is a second treap over the non-empty pieces of the chain,
+ * ordered by the address of their data. Marks are pointers into the blocks,
+ * since the data referenced by different pieces of the chain never overlaps,
+ * this allows to find the piece holding a mark in O(log n). The position of
+ * the piece is then recovered by walking up the position index. */
+static void mark_index_replace(Text *txt, Piece *p, Piece *c) {
+	Piece *parent = p->mark_parent;
+	if (!parent)
+		txt->mark_root = c;
+	else if (parent->mark_left == p)
+		parent->mark_left = c;
+	else
+		parent->mark_right = c;
+	if (c)
+		c->mark_parent = parent;
+}
+
+static void mark_index_rotate_up(Text *txt, Piece *p) {
+	Piece *parent = p->mark_parent;
+	mark_index_replace(txt, parent, p);
+	if (parent->mark_left == p) {
+		parent->mark_left = p->mark_right;
+		if (p->mark_right)
+			p->mark_right->mark_parent = parent;
+		p->mark_right = parent;
+	} else {
+		parent->mark_right = p->mark_left;
+		if (p->mark_left)
+			p->mark_left->mark_parent = parent;
+		p->mark_left = parent;
+	}
+	parent->mark_parent = p;
+}
+
+static void mark_index_insert(Text *txt, Piece *p) {
+	Piece *parent = NULL;
+	Piece **link = &txt->mark_root;
+	while (*link) {
+		parent = *link;
+		link = p->data < parent->data ? &parent->mark_left : &parent->mark_right;
+	}
+	*link = p;
+	p->mark_parent = parent;
+	p->mark_left = p->mark_right = NULL;
+	while (p->mark_parent && p->mark_parent->prio < p->prio)
+		mark_index_rotate_up(txt, p);
+}
+
+static void mark_index_remove(Text *txt, Piece *p) {
+	while (p->mark_left && p->mark_right) {
+		Piece *l = p->mark_left, *r = p->mark_right;
+		mark_index_rotate_up(txt, l->prio > r->prio ? l : r);
+	}
+	mark_index_replace(txt, p, p->mark_left ? p->mark_left : p->mark_right);
+	p->mark_parent = p->mark_left = p->mark_right = NULL;
+}
+
+/* returns the piece of the chain whose data contains mark or NULL */
+static Piece *mark_index_get(const Text *txt, Mark mark) {
+	Piece *p = txt->mark_root;
+	while (p) {
+		Mark start = (Mark)p->data;
+		if (mark < start)
+			p = p->mark_left;
+		else if (mark >= start + p->len)
+			p = p->mark_right;
+		else
+			return p;
+	}
+	return NULL;
 }
 
 /* returns the piece holding the text at byte offset pos. If pos happens to
@@ -338,11 +729,19 @@ static void piece_init(Piece *p, Piece *prev, Piece *next, const char *data, siz
  * in particular if pos is zero, the begin sentinel piece is returned.
  */
 static Location piece_get_intern(Text *txt, size_t pos) {
-	size_t cur = 0;
-	for (Piece *p = &txt->begin; p->next; p = p->next) {
-		if (cur <= pos && pos <= cur + p->len)
-			return (Location){ .piece = p, .off = pos - cur };
-		cur += p->len;
+	if (pos == 0)
+		return (Location){ .piece = &txt->begin, .off = 0 };
+
+	for (Piece *p = txt->root; p; ) {
+		size_t left = p->left ? p->left->weight : 0;
+		if (pos <= left) {
+			p = p->left;
+		} else if (pos <= left + p->len) {
+			return (Location){ .piece = p, .off = pos - left };
+		} else {
+			pos -= left + p->len;
+			p = p->right;
+		}
 	}
 
 	return (Location){ 0 };
@@ -354,18 +753,21 @@ static Location piece_get_intern(Text *txt, size_t pos) {
  * the last piece holding data is returned.
  */
 static Location piece_get_extern(const Text *txt, size_t pos) {
-	size_t cur = 0;
-	Piece *p;
-
-	for (p = txt->begin.next; p->next; p = p->next) {
-		if (cur <= pos && pos < cur + p->len)
-			return (Location){ .piece = p, .off = pos - cur };
-		cur += p->len;
+	if (pos == txt->size)
+		return (Location){ .piece = txt->end.prev, .off = txt->end.prev->len };
+
+	for (Piece *p = txt->root; p; ) {
+		size_t left = p->left ? p->left->weight : 0;
+		if (pos < left) {
+			p = p->left;
+		} else if (pos < left + p->len) {
+			return (Location){ .piece = p, .off = pos - left };
+		} else {
+			pos -= left + p->len;
+			p = p->right;
+		}
 	}
 
-	if (cur == pos)
-		return (Location){ .piece = p->prev, .off = p->prev->len };
-
 	return (Location){ 0 };
 }
 
@@ -378,7 +780,7 @@ static TextChange *text_change_alloc(Text *txt, size_t pos) {
 		if (!rev)
 			return NULL;
 	}
-	TextChange *c = calloc(1, sizeof *c);
+	TextChange *c = pool_alloc(&txt->changes);
 	if (!c)
 		return NULL;
 	c->pos = pos;
@@ -389,14 +791,14 @@ static TextChange *text_change_alloc(Text *txt, size_t pos) {
 	return c;
 }
 
-static void text_change_free(TextChange *c) {
-	if (!c)
-		return;
-	/* only free the new part of the span, the old one is still in use */
-	if (c->new.start != c->new.end)
-		piece_free(c->new.end);
-	piece_free(c->new.start);
-	free(c);
+/* release the most recent change of the current revision, which must
+ * not yet have been applied */
+static void text_change_free(Text *txt, TextChange *c) {
+	Revision *rev = txt->current_revision;
+	rev->change = c->next;
+	if (c->next)
+		c->next->prev = NULL;
+	pool_free(&txt->changes, c);
 }
 
 /* When inserting new data there are 2 cases to consider.
@@ -432,8 +834,6 @@ bool text_insert(Vis *vis, Text *txt, size_t pos, const void *data, size_t len)
 		return true;
 	if (pos > txt->size)
 		return false;
-	if (pos < txt->lines.pos)
-		lineno_cache_invalidate(&txt->lines);
 
 	Location loc = piece_get_intern(txt, pos);
 	Piece *p = loc.piece;
@@ -447,17 +847,22 @@ bool text_insert(Vis *vis, Text *txt, size_t pos, const void *data, size_t len)
 	if (!c)
 		return false;
 
-	if (!(data = block_store(vis, txt, data, len)))
+	if (!(data = block_store(vis, txt, data, len))) {
+		text_change_free(txt, c);
 		return false;
+	}
 
 	Piece *new = NULL;
 
 	if (off == p->len) {
 		/* insert between two existing pieces, hence there is nothing to
 		 * remove, just add a new piece holding the extra text */
-		if (!(new = piece_alloc(txt)))
+		if (!(new = piece_alloc(txt))) {
+			text_change_free(txt, c);
 			return false;
+		}
 		piece_init(new, p, p->next, data, len);
+		new->lines = lines_count(data, len);
 		span_init(&c->new, new, new);
 		span_init(&c->old, NULL, NULL);
 	} else {
@@ -469,11 +874,21 @@ bool text_insert(Vis *vis, Text *txt, size_t pos, const void *data, size_t len)
 		Piece *before = piece_alloc(txt);
 		new = piece_alloc(txt);
 		Piece *after = piece_alloc(txt);
-		if (!before || !new || !after)
+		if (!before || !new || !after) {
+			piece_free(before);
+			piece_free(new);
+			piece_free(after);
+			text_change_free(txt, c);
 			return false;
+		}
 		piece_init(before, p->prev, new, p->data, off);
 		piece_init(new, before, after, data, len);
 		piece_init(after, new, p->next, p->data + off, p->len - off);
+		new->lines = lines_count(data, len);
+		if (p->lines != LINES_UNKNOWN) {
+			before->lines = piece_lines_prefix(p, off);
+			after->lines = p->lines - before->lines;
+		}
 
 		span_init(&c->new, before, after);
 		span_init(&c->old, p, p);
@@ -516,7 +931,6 @@ size_t text_undo(Text *txt) {
 		return pos;
 	pos = revision_undo(txt, txt->history);
 	txt->history = rev;
-	lineno_cache_invalidate(&txt->lines);
 	return pos;
 }
 
@@ -529,7 +943,6 @@ size_t text_redo(Text *txt) {
 		return pos;
 	pos = revision_redo(txt, rev);
 	txt->history = rev;
-	lineno_cache_invalidate(&txt->lines);
 	return pos;
 }
 
@@ -552,7 +965,7 @@ static size_t history_traverse_to(Text *txt, Revision *rev) {
 	bool changed = history_change_branch(rev);
 	if (!changed) {
 		if (rev->seq == txt->history->seq) {
-			return txt->lines.pos;
+			return txt->history->change ? txt->history->change->pos : EPOS;
 		} else if (rev->seq > txt->history->seq) {
 			while (txt->history != rev)
 				pos = text_redo(txt);
@@ -605,11 +1018,10 @@ vis_text_load(Vis *vis, const char *filename, VisTextLoadMethod method)
 	Text *txt = calloc(1, sizeof *txt);
 	if (!txt)
 		return NULL;
-	Piece *p = piece_alloc(txt);
-	if (!p)
-		goto out;
+	txt->pieces.size = sizeof(Piece);
+	txt->changes.size = sizeof(TextChange);
+	txt->revisions.size = sizeof(Revision);
 	Block *block = 0;
-	lineno_cache_invalidate(&txt->lines);
 	if (filename) {
 		errno = 0;
 		block = block_load(AT_FDCWD, filename, method, &txt->info);
@@ -618,14 +1030,30 @@ vis_text_load(Vis *vis, const char *filename, VisTextLoadMethod method)
 		if (block) *da_push(vis, txt) = block;
 	}
 
-	if (!block)
-		piece_init(p, &txt->begin, &txt->end, "\0", 0);
-	else
-		piece_init(p, &txt->begin, &txt->end, block->data, block->len);
+	piece_init(&txt->begin, NULL, &txt->end, NULL, 0);
+	piece_init(&txt->end, &txt->begin, NULL, NULL, 0);
+	txt->seed = 2463534242;
+
+	/* reference the file content by pieces of bounded size, such that
+	 * counting the new lines within any of them stays cheap */
+	const char *data = block ? block->data : "\0";
+	size_t rem = block ? block->len : 0;
+	do {
+		size_t len = MIN(rem, BLOCK_CHUNK_SIZE);
+		Piece *p = piece_alloc(txt);
+		if (!p)
+			goto out;
+		piece_init(p, txt->end.prev, &txt->end, data, len);
+		p->prev->next = p;
+		txt->end.prev = p;
+		Span span;
+		span_init(&span, p, p);
+		span_index_insert(txt, &span);
+		txt->size += len;
+		data += len;
+		rem -= len;
+	} while (rem > 0);
 
-	piece_init(&txt->begin, NULL, p, NULL, 0);
-	piece_init(&txt->end, p, NULL, NULL, 0);
-	txt->size = p->len;
 	/* write an empty revision */
 	text_change_alloc(txt, EPOS);
 	text_snapshot(txt);
@@ -661,8 +1089,6 @@ bool text_delete(Text *txt, size_t pos, size_t len) {
 	size_t pos_end;
 	if (!addu(pos, len, &pos_end) || pos_end > txt->size)
 		return false;
-	if (pos < txt->lines.pos)
-		lineno_cache_invalidate(&txt->lines);
 
 	Location loc = piece_get_intern(txt, pos);
 	Piece *p = loc.piece;
@@ -691,8 +1117,10 @@ bool text_delete(Text *txt, size_t pos, size_t len) {
 		cur = p->len - off;
 		start = p;
 		before = piece_alloc(txt);
-		if (!before)
+		if (!before) {
+			text_change_free(txt, c);
 			return false;
+		}
 	}
 
 	/* skip all pieces which fall into deletion range */
@@ -710,14 +1138,22 @@ bool text_delete(Text *txt, size_t pos, size_t len) {
 		midway_end = true;
 		end = p;
 		after = piece_alloc(txt);
-		if (!after)
+		if (!after) {
+			if (midway_start)
+				piece_free(before);
+			text_change_free(txt, c);
 			return false;
+		}
 		piece_init(after, before, p->next, p->data + p->len - (cur - len), cur - len);
+		if (p->lines != LINES_UNKNOWN)
+			after->lines = p->lines - piece_lines_prefix(p, p->len - after->len);
 	}
 
 	if (midway_start) {
 		/* we finally know which piece follows our newly allocated before piece */
 		piece_init(before, start->prev, after, start->data, off);
+		if (start->lines != LINES_UNKNOWN)
+			before->lines = piece_lines_prefix(start, off);
 	}
 
 	Piece *new_start = NULL, *new_end = NULL;
@@ -745,25 +1181,159 @@ bool text_delete_range(Text *txt, Filerange r)
 	return text_delete(txt, r.start, text_range_size(r));
 }
 
-void text_free(Text *txt) {
-	if (!txt)
-		return;
+/* append a new piece referring to the given data to the list [*head, *tail] */
+static bool piece_append(Text *txt, Piece **head, Piece **tail, const char *data, size_t len, size_t lines) {
+	if (len == 0)
+		return true;
+	Piece *p = piece_alloc(txt);
+	if (!p)
+		return false;
+	piece_init(p, *tail, NULL, data, len);
+	p->lines = lines;
+	if (*tail)
+		(*tail)->next = p;
+	else
+		*head = p;
+	*tail = p;
+	return true;
+}
+
+/* Edits are applied from left to right. Consecutive edits affecting the same
+ * or adjacent pieces form a cluster which is recorded as a single change:
+ * its pieces are replaced by fragments of their remaining content interleaved
+ * with the inserted data.
+ *
+ *      /-+ --> +-----------------------+ --> +-\
+ *      | |     | foo bar foo bar foo   |     | |
+ *      \-+ <-- +-----------------------+ <-- +-/
+ *                ^^^     ^^^     ^^^
+ *                replace foo by baz
+ *
+ *      /-+ --> +---+ --> +-----+ --> +---+ --> +-----+ --> +---+ --> +-\
+ *      | |     |baz|     | bar |     |baz|     | bar |     |baz|     | |
+ *      \-+ <-- +---+ <-- +-----+ <-- +---+ <-- +-----+ <-- +---+ <-- +-/
+ *
+ * Pieces between clusters are located through the position index, hence the
+ * cost does not depend on the distance between edits.
+ */
+static size_t edit_len(const TextEdit *e) {
+	return e->input ? e->input->len : e->len;
+}
 
-	// free history
-	Revision *hist = txt->history;
-	while (hist && hist->prev)
-		hist = hist->prev;
-	while (hist) {
-		Revision *later = hist->later;
-		revision_free(hist);
-		hist = later;
+bool text_edit_batch(Vis *vis, Text *txt, const TextEdit *edits, size_t count) {
+	for (size_t i = 0, prev = 0; i < count; prev = edits[i++].range.end) {
+		Filerange r = edits[i].range;
+		if (!text_range_valid(r) || r.start < prev || r.end > txt->size)
+			return false;
 	}
 
-	for (Piece *next, *p = txt->pieces; p; p = next) {
-		next = p->global_next;
-		piece_free(p);
+	size_t grown = 0, shrunk = 0; /* size difference caused by already applied edits */
+	for (size_t i = 0; i < count; ) {
+		if (text_range_size(edits[i].range) == 0 && edit_len(&edits[i]) == 0) {
+			i++;
+			continue;
+		}
+
+		size_t pos = edits[i].range.start + grown - shrunk;
+		TextChange *c = text_change_alloc(txt, pos);
+		if (!c)
+			return false;
+
+		Piece *p = NULL, *before, *first = NULL, *head = NULL, *tail = NULL;
+		size_t off = 0;
+		if (pos == txt->size) {
+			/* only insertions at the end of the text */
+			before = txt->end.prev;
+		} else {
+			Location loc = piece_get_extern(txt, pos);
+			p = first = loc.piece;
+			off = loc.off;
+			before = p->prev;
+			if (!piece_append(txt, &head, &tail, p->data, off, LINES_UNKNOWN))
+				goto err;
+		}
+
+		for (;;) {
+			const TextEdit *e = &edits[i++];
+			if (e->input) {
+				for (VisDACount j = 0; j < e->input->count; j++) {
+					const TextInputChunk *chunk = e->input->data + j;
+					if (!piece_append(txt, &head, &tail, chunk->data, chunk->len, chunk->lines))
+						goto err;
+				}
+			} else if (e->len > 0) {
+				const char *data = block_store(vis, txt, e->data, e->len);
+				if (!data || !piece_append(txt, &head, &tail, data, e->len, lines_count(data, e->len)))
+					goto err;
+			}
+			for (size_t len = text_range_size(e->range); len > 0; ) {
+				size_t n = MIN(len, p->len - off);
+				off += n;
+				len -= n;
+				if (off == p->len && len > 0) {
+					p = p->next;
+					off = 0;
+				}
+			}
+			grown += edit_len(e);
+			shrunk += text_range_size(e->range);
+
+			while (i < count && text_range_size(edits[i].range) == 0 && edit_len(&edits[i]) == 0)
+				i++;
+			if (i == count)
+				break;
+			/* continue the cluster if the next edit lies within the current or the following piece */
+			size_t gap = edits[i].range.start - e->range.end;
+			size_t avail = p ? p->len - off + (p->next != &txt->end ? p->next->len : 0) : 0;
+			if (gap > avail)
+				break;
+			while (gap > 0) {
+				if (off == p->len) {
+					p = p->next;
+					off = 0;
+				}
+				size_t n = MIN(gap, p->len - off);
+				size_t lines = n == p->len ? p->lines : LINES_UNKNOWN;
+				if (!piece_append(txt, &head, &tail, p->data + off, n, lines))
+					goto err;
+				off += n;
+				gap -= n;
+			}
+		}
+
+		if (p && !piece_append(txt, &head, &tail, p->data + off, p->len - off, off == 0 ? p->lines : LINES_UNKNOWN))
+			goto err;
+
+		Piece *after = p ? p->next : before->next;
+		if (head) {
+			head->prev = before;
+			tail->next = after;
+		}
+		span_init(&c->new, head, tail);
+		span_init(&c->old, first, p);
+		span_swap(txt, &c->old, &c->new);
+		continue;
+err:
+		for (Piece *next; head; head = next) {
+			next = head->next;
+			piece_free(head);
+		}
+		text_change_free(txt, c);
+		return false;
 	}
 
+	return true;
+}
+
+void text_free(Text *txt) {
+	if (!txt)
+		return;
+
+	/* pieces and history are released in bulk */
+	pool_release(&txt->pieces);
+	pool_release(&txt->changes);
+	pool_release(&txt->revisions);
+
 	for (VisDACount i = 0; i < txt->count; i++)
 		block_free(txt->data[i]);
 	da_release(txt);
@@ -771,6 +1341,19 @@ void text_free(Text *txt) {
 	free(txt);
 }
 
+TextMemoryStats text_memory_stats(const Text *txt) {
+	return (TextMemoryStats){
+		.pieces = txt->pieces.objects,
+		.changes = txt->changes.objects,
+		.revisions = txt->revisions.objects,
+		.bytes = txt->pieces.bytes + txt->changes.bytes + txt->revisions.bytes,
+	};
+}
+
+size_t text_version(const Text *txt) {
+	return txt->version;
+}
+
 bool text_modified(const Text *txt) {
 	return txt->saved_revision != txt->history;
 }
@@ -840,100 +1423,86 @@ size_t text_size(const Text *txt) {
 	return txt->size;
 }
 
-/* count the number of new lines '\n' in range [pos, pos+len) */
-static size_t lines_count(Text *txt, size_t pos, size_t len) {
-	size_t lines = 0;
-	for (Iterator it = text_iterator_get(txt, pos);
-	     text_iterator_valid(&it);
-	     text_iterator_next(&it)) {
-		const char *start = it.text;
-		while (len > 0 && start < it.end) {
-			size_t n = MIN(len, (size_t)(it.end - start));
-			const char *end = memory_scan_forward(start, '\n', n);
-			if (!end) {
-				len -= n;
-				break;
-			}
-			lines++;
-			len -= end - start + 1;
-			start = end + 1;
-		}
+/* count the number of new lines '\n' in data */
+static size_t lines_count(const char *data, size_t len) {
+	return memory_count(data, '\n', len);
+}
 
-		if (len == 0)
-			break;
-	}
-	return lines;
-}
-
-/* skip n lines forward and return position afterwards */
-static size_t lines_skip_forward(Text *txt, size_t pos, size_t lines, size_t *lines_skipped) {
-	size_t lines_old = lines;
-	for (Iterator it = text_iterator_get(txt, pos);
-	     text_iterator_valid(&it);
-	     text_iterator_next(&it)) {
-		const char *start = it.text;
-		while (lines > 0 && start < it.end) {
-			size_t n = it.end - start;
-			const char *end = memory_scan_forward(start, '\n', n);
-			if (!end) {
-				pos += n;
-				break;
-			}
-			pos += end - start + 1;
-			start = end + 1;
-			lines--;
-		}
+static size_t piece_lines(Piece *p) {
+	if (p->lines == LINES_UNKNOWN)
+		p->lines = lines_count(p->data, p->len);
+	return p->lines;
+}
 
-		if (lines == 0)
-			break;
-	}
-	if (lines_skipped)
-		*lines_skipped = lines_old - lines;
-	return pos;
+/* count the number of new lines in the first off bytes of the piece, if
+ * the total is already known only the smaller part is scanned */
+static size_t piece_lines_prefix(Piece *p, size_t off) {
+	if (p->lines != LINES_UNKNOWN && off > p->len / 2)
+		return p->lines - lines_count(p->data + off, p->len - off);
+	return lines_count(p->data, off);
 }
 
-static void lineno_cache_invalidate(LineCache *cache) {
-	cache->pos = 0;
-	cache->lineno = 1;
+/* the number of new lines in the subtree rooted at p, counts and caches
+ * the new lines of all pieces which have not been inspected yet */
+static size_t index_lines(Piece *p) {
+	if (!p)
+		return 0;
+	if (p->weight_lines == LINES_UNKNOWN) {
+		size_t lines = index_lines(p->left) + piece_lines(p);
+		p->weight_lines = lines + index_lines(p->right);
+	}
+	return p->weight_lines;
 }
 
 size_t text_pos_by_lineno(Text *txt, size_t lineno) {
-	size_t lines_skipped;
-	LineCache *cache = &txt->lines;
 	if (lineno <= 1)
 		return 0;
-	if (lineno > cache->lineno) {
-		cache->pos = lines_skip_forward(txt, cache->pos, lineno - cache->lineno, &lines_skipped);
-		cache->lineno += lines_skipped;
-	} else if (lineno < cache->lineno) {
-	#if 0
-		// TODO does it make sense to scan memory backwards here?
-		size_t diff = cache->lineno - lineno;
-		if (diff < lineno) {
-			lines_skip_backward(txt, cache->pos, diff);
-		} else
-	#endif
-		cache->pos = lines_skip_forward(txt, 0, lineno - 1, &lines_skipped);
-		cache->lineno = lines_skipped + 1;
-	}
-	return cache->lineno == lineno ? cache->pos : EPOS;
+	size_t pos = 0, lines = lineno - 1; /* new lines to skip */
+	for (Piece *p = txt->root; p; ) {
+		size_t left = index_lines(p->left);
+		if (lines <= left) {
+			p = p->left;
+			continue;
+		}
+		lines -= left;
+		pos += p->left ? p->left->weight : 0;
+		if (lines > piece_lines(p)) {
+			lines -= p->lines;
+			pos += p->len;
+			p = p->right;
+			continue;
+		}
+		/* the new line ending the previous line is within this piece */
+		const char *start = p->data, *end = p->data + p->len, *nl = NULL;
+		if (lines > p->lines / 2) {
+			for (size_t n = p->lines - lines + 1; n > 0; n--, end = nl)
+				nl = memory_scan_reverse(start, '\n', end - start);
+		} else {
+			for (; lines > 0; lines--, start = nl + 1)
+				nl = memory_scan_forward(start, '\n', end - start);
+		}
+		return pos + (nl - p->data) + 1;
+	}
+	return EPOS;
 }
 
 size_t text_lineno_by_pos(Text *txt, size_t pos) {
-	LineCache *cache = &txt->lines;
-	if (pos > txt->size)
-		pos = txt->size;
-	if (pos < cache->pos) {
-		size_t diff = cache->pos - pos;
-		if (diff < pos)
-			cache->lineno -= lines_count(txt, pos, diff);
-		else
-			cache->lineno = lines_count(txt, 0, pos) + 1;
-	} else if (pos > cache->pos) {
-		cache->lineno += lines_count(txt, cache->pos, pos - cache->pos);
+	if (pos >= txt->size)
+		return index_lines(txt->root) + 1;
+	size_t lines = 0;
+	for (Piece *p = txt->root; p; ) {
+		size_t left = p->left ? p->left->weight : 0;
+		if (pos < left) {
+			p = p->left;
+		} else if (pos < left + p->len) {
+			return lines + index_lines(p->left) + piece_lines_prefix(p, pos - left) + 1;
+		} else {
+			lines += index_lines(p->left) + piece_lines(p);
+			pos -= left + p->len;
+			p = p->right;
+		}
 	}
-	cache->pos = text_line_begin(txt, pos);
-	return cache->lineno;
+	return lines + 1;
 }
 
 Mark text_mark_set(Text *txt, size_t pos) {
@@ -946,20 +1515,48 @@ Mark text_mark_set(Text *txt, size_t pos) {
 }
 
 size_t text_mark_get(const Text *txt, Mark mark) {
-	size_t cur = 0;
-
 	if (mark == EMARK)
 		return EPOS;
 	if (mark == (Mark)&txt->end)
 		return txt->size;
 
-	for (Piece *p = txt->begin.next; p->next; p = p->next) {
-		Mark start = (Mark)(p->data);
-		Mark end = start + p->len;
-		if (start <= mark && mark < end)
-			return cur + (mark - start);
-		cur += p->len;
-	}
+	Piece *p = mark_index_get(txt, mark);
+	if (!p)
+		return EPOS;
+	return index_position(p) + (mark - (Mark)p->data);
+}
 
-	return EPOS;
+void text_marks_get(const Text *txt, const Mark *marks, size_t *pos, size_t count) {
+	const Piece *p = NULL; /* piece holding the previous mark */
+	size_t start = 0;      /* absolute position of p */
+
+	for (size_t i = 0; i < count; i++) {
+		Mark mark = marks[i];
+		pos[i] = EPOS;
+		if (mark == EMARK)
+			continue;
+		if (mark == (Mark)&txt->end) {
+			pos[i] = txt->size;
+			continue;
+		}
+
+		/* marks ordered by position are likely to be found in the same
+		 * or one of the following pieces, only consult the index if a
+		 * short walk along the chain does not succeed */
+		for (int steps = 0; p && p->next && steps < 8; steps++) {
+			if ((Mark)p->data <= mark && mark < (Mark)p->data + p->len)
+				break;
+			start += p->len;
+			p = p->next;
+		}
+
+		if (!p || !((Mark)p->data <= mark && mark < (Mark)p->data + p->len)) {
+			p = mark_index_get(txt, mark);
+			if (!p)
+				continue;
+			start = index_position(p);
+		}
+
+		pos[i] = start + (mark - (Mark)p->data);
+	}
 }
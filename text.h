@@ -116,6 +116,20 @@ VIS_INTERNAL size_t text_size(const Text*);
 VIS_INTERNAL struct stat text_stat(const Text*);
 /** Query whether the text contains any unsaved modifications. */
 VIS_INTERNAL bool text_modified(const Text*);
+/**
+ * Get a counter which changes whenever the text content is modified,
+ * including by undo and redo operations.
+ */
+VIS_INTERNAL size_t text_version(const Text*);
+/** Memory used to track the content and the undo history of a text. */
+typedef struct {
+	size_t pieces;     /**< Number of pieces in use. */
+	size_t changes;    /**< Number of changes in use. */
+	size_t revisions;  /**< Number of revisions in use. */
+	size_t bytes;      /**< Memory reserved to store them, in bytes. */
+} TextMemoryStats;
+/** Get the current memory statistics of the text. */
+VIS_INTERNAL TextMemoryStats text_memory_stats(const Text*);
 /**
  * @}
  * @defgroup modify Text Modification
@@ -142,6 +156,70 @@ VIS_INTERNAL bool text_insert(Vis *vis, Text *txt, size_t pos, const void *data,
  */
 VIS_INTERNAL bool text_delete(Text *txt, size_t pos, size_t len);
 VIS_INTERNAL bool text_delete_range(Text *txt, Filerange);
+/** A contiguous part of ``TextInput`` stored in a block of the text. */
+typedef struct {
+	const char *data;
+	size_t len;
+	size_t lines;      /**< Number of new lines in ``data``. */
+} TextInputChunk;
+/**
+ * Content stored in the blocks of a text ahead of its insertion.
+ *
+ * Data read from a file descriptor ends up in its final location, inserting
+ * it with ``text_edit_batch`` merely references it. Must be zero initialized.
+ */
+typedef struct {
+	TextInputChunk *data;
+	VisDACount count;
+	VisDACount capacity;
+	size_t len;        /**< Total length of all chunks in bytes. */
+} TextInput;
+/**
+ * Read once from a file descriptor into free space of the text's blocks.
+ *
+ * @return The result of the underlying ``read(2)``.
+ */
+VIS_INTERNAL ssize_t text_input_read(Vis *vis, Text *txt, TextInput *in, int fd);
+/**
+ * Copy data into free space of the text's blocks.
+ *
+ * @return Whether the data could be stored.
+ */
+VIS_INTERNAL bool text_input_append(Vis *vis, Text *txt, TextInput *in, const char *data, size_t len);
+/**
+ * Forget about the content, once it was inserted.
+ */
+VIS_INTERNAL void text_input_release(TextInput *in);
+/**
+ * Drop content which was not inserted, its storage is reclaimed unless
+ * other data was stored in the meantime.
+ */
+VIS_INTERNAL void text_input_discard(Text *txt, TextInput *in);
+/** A single modification performed by ``text_edit_batch``. */
+typedef struct {
+	Filerange range;  /**< Range to replace, empty for insertions. Refers to the text prior to the batch. */
+	const char *data; /**< Replacement content. */
+	size_t len;       /**< Length of ``data`` in bytes. */
+	const TextInput *input; /**< Replacement content already stored in the text, used instead of ``data`` if set. */
+} TextEdit;
+
+typedef struct {
+	TextEdit   *data;
+	VisDACount  count;
+	VisDACount  capacity;
+} TextEditList;
+/**
+ * Apply multiple modifications in a single pass over the text.
+ *
+ * @param vis The editor instance.
+ * @param txt The text instance to modify.
+ * @param edits The edits, sorted by position and not overlapping. Insertions
+ *        at the same position are performed in the given order.
+ * @param count The number of edits.
+ * @return Whether all edits were applied. Upon allocation failure only some
+ *         of them might have been performed.
+ */
+VIS_INTERNAL bool text_edit_batch(Vis *vis, Text *txt, const TextEdit *edits, size_t count);
 #define text_append_literal(vis, text, s) text_append(vis, text, str8(s))
 VIS_INTERNAL bool text_append(Vis *vis, Text *txt, str8 string);
 VIS_INTERNAL bool text_appendf(Vis *vis, Text *txt, const char *format, ...) __attribute__((format(printf, 3, 4)));
@@ -234,6 +312,38 @@ VIS_INTERNAL size_t text_bytes_get(const Text *txt, size_t pos, size_t len, char
  * @endrst
  */
 VIS_INTERNAL char *text_bytes_alloc0(const Text *txt, size_t pos, size_t len);
+/**
+ * Content of a range as read-only slices of the underlying storage.
+ *
+ * Avoids copying the content for consumers which merely read it:
+ *
+ * @rst
+ * .. code-block:: c
+ *
+ *    str8 chunk;
+ *    for (TextChunks c = text_chunks_get(txt, range); text_chunks_next(&c, &chunk); )
+ *            consume(chunk.data, chunk.length);
+ *
+ * .. warning:: The slices are only valid until the text is modified.
+ * @endrst
+ */
+typedef struct {
+	Iterator it;    /**< Position of the next slice. */
+	size_t rem;     /**< Number of bytes of the range not yet returned. */
+} TextChunks;
+VIS_INTERNAL TextChunks text_chunks_get(const Text*, Filerange);
+/**
+ * Advance to the next slice of the range.
+ * @return Whether a non-empty slice was stored in ``chunk``.
+ */
+VIS_INTERNAL bool text_chunks_next(TextChunks*, str8 *chunk);
+/**
+ * Whether the content of a slice stays unchanged as long as the text exists.
+ *
+ * This is the case for everything but the most recently modified piece,
+ * which is extended in place by subsequent insertions and deletions.
+ */
+VIS_INTERNAL bool text_chunk_stable(const Text*, str8 chunk);
 /**
  * @}
  * @defgroup iterator Text Iterators
@@ -294,6 +404,19 @@ VIS_INTERNAL Mark text_mark_set(Text *txt, size_t pos);
  * @return The byte position or ``EPOS`` for an invalid mark.
  */
 VIS_INTERNAL size_t text_mark_get(const Text *txt, Mark mark);
+/**
+ * Lookup multiple marks at once.
+ * @param txt The text instance to query.
+ * @param marks The marks to look up.
+ * @param pos Destination array of ``count`` elements, invalid marks
+ *            resolve to ``EPOS``.
+ * @param count The number of marks.
+ * @rst
+ * .. note:: Most efficient if the marks are sorted by position, subsequent
+ *           marks are then typically resolved without an index lookup.
+ * @endrst
+ */
+VIS_INTERNAL void text_marks_get(const Text *txt, const Mark *marks, size_t *pos, size_t count);
 /**
  * @}
  * @defgroup save Text Saving
@@ -343,13 +466,26 @@ typedef struct {
 	str8 tmpname;              /* temporary name used for atomic rename(2) */
 	int fd;                    /* file descriptor to write data to using text_save_write */
 	int dirfd;                 /* directory file descriptor, relative to which we save */
+	bool rewrite;              /* in-place save over the mmap-ed file, unchanged parts are skipped */
+	size_t offset;             /* file position of the next write when rewriting */
+	int pinfd;                 /* temporary file holding pages pinned while rewriting */
+	struct Revision *revision; /* revision being saved, the current one at text_save_begin */
+	struct stat meta;          /* file information of the saved file once committed */
+	str8_list snapshot;        /* content to write, see text_save_snapshot */
+	char *copy;                /* copy of the parts of the snapshot which might still change */
+	const struct Block *orig;  /* mmap-ed file unmodified parts of the snapshot are copied from */
 } TextSave;
-#define text_save_default(...) (TextSave){.dirfd = AT_FDCWD, .fd = -1, __VA_ARGS__}
+#define text_save_default(...) (TextSave){.dirfd = AT_FDCWD, .fd = -1, .pinfd = -1, __VA_ARGS__}
 
 /**
  * Marks the current text revision as saved.
  */
 VIS_INTERNAL void text_mark_current_revision(Text*);
+/**
+ * Marks the revision a save operation started from as saved, for when
+ * it was committed by ``text_save_commit_snapshot``.
+ */
+VIS_INTERNAL void text_mark_saved(TextSave*);
 
 /**
  * Setup a sequence of write operations.
@@ -377,6 +513,27 @@ VIS_INTERNAL ssize_t text_save_write_range(TextSave*, Filerange);
  * @endrst
  */
 VIS_INTERNAL bool text_save_commit(TextSave*);
+/**
+ * Record the content of file ranges for ``text_save_commit_snapshot``.
+ *
+ * Only the slices of the underlying storage are remembered, content which
+ * might still be changed in place is copied.
+ * @return Whether the snapshot was taken, otherwise the save can be continued
+ *         by means of ``text_save_write_range``.
+ */
+VIS_INTERNAL bool text_save_snapshot(TextSave*, const Filerange *ranges, size_t count);
+/**
+ * Write the snapshot and commit it to disk.
+ *
+ * The text is not accessed, hence it may be modified concurrently by another
+ * thread. Only atomic saves are supported.
+ * @return Whether changes have been saved.
+ * @rst
+ * .. note:: Like ``text_save_commit`` releases the underlying resources, but
+ *           ``text_mark_saved`` has yet to be called on success.
+ * @endrst
+ */
+VIS_INTERNAL bool text_save_commit_snapshot(TextSave*);
 /**
  * Abort a save operation.
  * @rst
@@ -391,6 +548,21 @@ VIS_INTERNAL void text_save_cancel(TextSave*);
  * @return The number of bytes written or ``-1`` in case of an error.
  */
 VIS_INTERNAL ssize_t text_write_range(const Text*, Filerange, int fd);
+/**
+ * Write file range to a pipe without copying the content where possible.
+ *
+ * On Linux the pages are handed over using ``vmsplice(2)``, unmodified
+ * content of a memory mapped file is passed on from the page cache using
+ * ``splice(2)``.
+ * Unlike ``text_write_range`` it stops at the first partial write, hence
+ * it is suitable for non-blocking pipes.
+ * @rst
+ * .. warning:: The pipe references the text content until it was read, the
+ *              text must not be modified or freed in the meantime.
+ * @endrst
+ * @return The number of bytes written or ``-1`` if nothing could be written.
+ */
+VIS_INTERNAL ssize_t text_pipe_range(const Text*, Filerange, int fd);
 /**
  * @}
  * @defgroup misc Miscellaneous
@@ -434,6 +606,31 @@ VIS_INTERNAL int text_regex_match(Regex*, const char *data, int eflags);
 VIS_INTERNAL int text_search_range_forward(Text*, size_t pos, size_t len, Regex *r, size_t nmatch, RegexMatch pmatch[], int eflags);
 VIS_INTERNAL int text_search_range_backward(Text*, size_t pos, size_t len, Regex *r, size_t nmatch, RegexMatch pmatch[], int eflags);
 
+/**
+ * Cursor yielding successive matches of a regex within a range.
+ *
+ * Consecutive calls to ``text_regex_cursor_next`` with non-decreasing
+ * positions search the range in a single pass, content already read
+ * for an earlier match is reused.
+ *
+ * @rst
+ * .. warning:: Any change to the Text, or another search using the same
+ *              Regex, invalidates the cursor state.
+ * @endrst
+ */
+typedef struct {
+	Text *txt;       /**< Text being searched. */
+	Regex *regex;    /**< Compiled pattern. */
+	Filerange range; /**< Range to which all matches are confined. */
+} RegexCursor;
+
+VIS_INTERNAL RegexCursor text_regex_cursor(Text*, Regex*, Filerange);
+/**
+ * Find the first match starting at or after ``pos``.
+ * @return ``0`` on success, ``REG_NOMATCH`` otherwise.
+ */
+VIS_INTERNAL int text_regex_cursor_next(RegexCursor*, size_t pos, size_t nmatch, RegexMatch pmatch[], int eflags);
+
 /** @} */
 
 /*
@@ -182,6 +182,9 @@ vis_ui_curses_color_pair_get(Ui *ui, u16 fg, u16 bg)
 		pair_content(cui->color_pair_current, &oldfg, &oldbg);
 		u32 old_index = vis_ui_curses_color_pair_hash(oldfg, oldbg);
 		if (init_pair(cui->color_pair_current, fg, bg) == OK) {
+			/* cells already on screen might have used the old pair */
+			if (cui->palette[old_index] == cui->color_pair_current)
+				cui->flush_terminal = true;
 			cui->palette[old_index] = 0;
 			cui->palette[index] = cui->color_pair_current;
 		}
@@ -206,28 +209,56 @@ vis_ui_curses_style_to_attr(Ui *ui, VisCellStyle style)
 }
 
 static void ui_term_backend_blit(Ui *tui) {
+	VisCursesUI *cui = &tui->curses;
 	int w = tui->width, h = tui->height;
 	VisCellData  *cell  = tui->cell_buffer.cells;
 	VisCellStyle *style = tui->cell_buffer.styles;
-	for (int y = 0; y < h; y++) {
+	VisCellData  *front_cell  = cui->cell_buffer.cells;
+	VisCellStyle *front_style = cui->cell_buffer.styles;
+	bool flush = cui->flush_terminal || !front_cell;
+	cui->flush_terminal = false;
+	for (int y = 0; y < h; y++, cell += w, style += w) {
+		if (!flush && !memcmp(front_cell + y * w, cell, w * sizeof(*cell)) &&
+		    !memcmp(front_style + y * w, style, w * sizeof(*style)))
+			continue;
 		for (int x = 0; x < w; x++) {
-			attrset(vis_ui_curses_style_to_attr(tui, *style));
-			mvaddnstr(y, x, (char *)cell->data, cell->data_length);
-			cell++;
-			style++;
+			attrset(vis_ui_curses_style_to_attr(tui, style[x]));
+			mvaddnstr(y, x, (char *)cell[x].data, cell[x].data_length);
+		}
+		if (front_cell) {
+			memcpy(front_cell + y * w, cell, w * sizeof(*cell));
+			memcpy(front_style + y * w, style, w * sizeof(*style));
 		}
 	}
 	move(tui->cur_row, tui->cur_col);
 	wnoutrefresh(stdscr);
-	if (tui->doupdate)
+	if (tui->doupdate) {
+		/* let the terminal display the frame at once */
+		if (tui->synchronized_output) {
+			fputs("\x1b[?2026h", stderr);
+			fflush(stderr);
+		}
 		doupdate();
+		if (tui->synchronized_output) {
+			fputs("\x1b[?2026l", stderr);
+			fflush(stderr);
+		}
+	}
 }
 
 static void ui_term_backend_clear(Ui *tui) {
 	clear();
+	tui->curses.flush_terminal = true;
 }
 
 static bool ui_term_backend_resize(Ui *tui, int width, int height) {
+	tui->curses.flush_terminal = true;
+	if (!vis_cell_buffer_resize(&tui->curses.cell_buffer, width, height)) {
+		/* without a front buffer every row is drawn */
+		if (tui->curses.cell_buffer.size)
+			munmap(tui->curses.cell_buffer.cells, tui->curses.cell_buffer.size);
+		tui->curses.cell_buffer = (VisCellBuffer){0};
+	}
 	return resizeterm(height, width) == OK &&
 	       wresize(stdscr, height, width) == OK;
 }
@@ -244,6 +275,7 @@ static void ui_term_backend_save(Ui *tui, bool fscr) {
 static void ui_term_backend_restore(Ui *tui) {
 	reset_prog_mode();
 	wclear(stdscr);
+	tui->curses.flush_terminal = true;
 }
 
 int ui_terminal_colors(void) {
@@ -294,5 +326,6 @@ vis_ui_backend_free(Ui *ui)
 {
 	ui_term_backend_suspend(ui);
 	free(ui->curses.palette);
+	if (ui->curses.cell_buffer.size) munmap(ui->curses.cell_buffer.cells, ui->curses.cell_buffer.size);
 	endwin();
 }
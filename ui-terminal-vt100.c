@@ -11,8 +11,15 @@
  *  - CSI ? 1049 l             Use Normal Screen Buffer and restore cursor (DECRST)
  *  - CSI ? 25 l               Hide Cursor (DECTCEM)
  *  - CSI ? 25 h               Show Cursor (DECTCEM)
+ *  - CSI ? 2026 $ p           Request Synchronized Output Mode (DECRQM)
+ *  - CSI ? 2026 h             Begin Synchronized Update
+ *  - CSI ? 2026 l             End Synchronized Update
  *  - CSI 2 J                  Erase in Display (ED)
  *  - CSI row ; column H       Cursor Position (CUP)
+ *  - CSI top ; bottom r       Set Scrolling Region (DECSTBM)
+ *  - CSI r                    Reset Scrolling Region (DECSTBM)
+ *  - CSI n S                  Scroll Up n lines (SU)
+ *  - CSI n T                  Scroll Down n lines (SD)
  *  - CSI ... m                Character Attributes (SGR)
  *    - CSI 0 m                     Normal
  *    - CSI 1 m                     Bold
@@ -32,6 +39,9 @@
  *
  * See http://invisible-island.net/xterm/ctlseqs/ctlseqs.txt
  * for further information.
+ *
+ * If the environment variable VIS_VT100_STATS is set, the number of frames,
+ * bytes written and scrolled regions are reported upon exit.
  */
 #define UI_TERMKEY_FLAGS 0
 
@@ -130,6 +140,96 @@ vis_ui_vt100_cursor_visible(bool visible)
 	vis_ui_vt100_output(visible ? str8("\x1b[?25h") : str8("\x1b[?25l"));
 }
 
+VIS_INTERNAL u64
+vis_ui_vt100_row_hash(VisCellBuffer *cb, s32 width, s32 row)
+{
+	// NOTE(rnp): FNV-1a over the cells and styles of a row
+	u64 *cells  = (u64 *)(cb->cells  + row * width);
+	u64 *styles = (u64 *)(cb->styles + row * width);
+	u64 result  = 0xcbf29ce484222325ull;
+	for (s32 i = 0; i < width; i++) {
+		result = (result ^ cells[i])  * 0x100000001b3ull;
+		result = (result ^ styles[i]) * 0x100000001b3ull;
+	}
+	return result;
+}
+
+/* Find the vertical range of rows which, when scrolled by some lines, makes
+ * the most front buffer rows match the back buffer. If redrawing fewer rows
+ * pays off, the terminal is instructed to scroll that region and the front
+ * buffer is updated accordingly. The revealed rows are cleared and redrawn
+ * by the regular cell diffing. */
+VIS_INTERNAL bool
+vis_ui_vt100_scroll(Ui *ui, Buffer *buf)
+{
+	VisVT100UI *vt = &ui->vt100;
+	s32 width = ui->width, height = ui->height;
+	u64 *front = vt->row_hashes, *back = vt->row_hashes + height;
+	for (s32 row = 0; row < height; row++) {
+		front[row] = vis_ui_vt100_row_hash(&vt->cell_buffer, width, row);
+		back[row]  = vis_ui_vt100_row_hash(&ui->cell_buffer, width, row);
+	}
+
+	// NOTE(rnp): back buffer row y shows front buffer row y + shift for all y in [first, last]
+	s32 best_gain = 0, best_first = 0, best_last = 0, best_shift = 0;
+	for (s32 shift = 1 - height; shift < height; shift++) {
+		if (shift == 0)
+			continue;
+		s32 end = MIN(height, height - shift);
+		for (s32 y = MAX(0, -shift); y < end;) {
+			if (back[y] != front[y + shift]) {
+				y++;
+				continue;
+			}
+			s32 first = y, gain = 0;
+			for (; y < end && back[y] == front[y + shift]; y++)
+				gain += back[y] != front[y];
+			s32 last = y - 1;
+			// NOTE(rnp): rows revealed by scrolling need to be redrawn
+			s32 revealed_first = shift > 0 ? last + 1     : first + shift;
+			s32 revealed_last  = shift > 0 ? last + shift : first - 1;
+			for (s32 row = revealed_first; row <= revealed_last; row++)
+				gain -= back[row] == front[row];
+			if (gain > best_gain) {
+				best_gain  = gain;
+				best_first = first;
+				best_last  = last;
+				best_shift = shift;
+			}
+		}
+	}
+
+	if (best_gain == 0)
+		return false;
+
+	// NOTE(rnp): don't trust the hashes blindly
+	for (s32 row = best_first; row <= best_last; row++) {
+		s32 src = (row + best_shift) * width, dst = row * width;
+		if (memcmp(vt->cell_buffer.cells  + src, ui->cell_buffer.cells  + dst, width * sizeof(VisCellData)) ||
+		    memcmp(vt->cell_buffer.styles + src, ui->cell_buffer.styles + dst, width * sizeof(VisCellStyle)))
+			return false;
+	}
+
+	s32 top    = best_shift > 0 ? best_first : best_first + best_shift;
+	s32 bottom = best_shift > 0 ? best_last + best_shift : best_last;
+	s32 lines  = best_shift > 0 ? best_shift : -best_shift;
+	// NOTE(rnp): reset attributes first, revealed lines are filled with the current background
+	vis_buffer_appendf(buf, "\x1b[0m" "\x1b[%d;%dr" "\x1b[%d%c" "\x1b[r", top + 1, bottom + 1,
+	                   lines, best_shift > 0 ? 'S' : 'T');
+
+	s32 rows = best_last - best_first + 1;
+	s32 src  = (best_first + best_shift) * width, dst = best_first * width;
+	memmove(vt->cell_buffer.cells  + dst, vt->cell_buffer.cells  + src, rows * width * sizeof(VisCellData));
+	memmove(vt->cell_buffer.styles + dst, vt->cell_buffer.styles + src, rows * width * sizeof(VisCellStyle));
+
+	s32 revealed = best_shift > 0 ? best_last + 1 : top;
+	memset(vt->cell_buffer.cells  + revealed * width, 0, lines * width * sizeof(VisCellData));
+	memset(vt->cell_buffer.styles + revealed * width, 0, lines * width * sizeof(VisCellStyle));
+
+	vt->scrolls++;
+	return true;
+}
+
 VIS_INTERNAL void
 ui_term_backend_blit(Ui *ui)
 {
@@ -137,6 +237,12 @@ ui_term_backend_blit(Ui *ui)
 	Buffer     *buf = &vt->output_buffer;
 	buf->length = 0;
 
+	// NOTE(rnp): if supported, the terminal displays the whole frame at once
+	if (ui->synchronized_output) {
+		str8 begin = str8("\x1b[?2026h");
+		buffer_append(buf, begin.data, begin.length);
+	}
+
 	s32 cell_count = ui->width * ui->height;
 
 	if unlikely(vt->flush_terminal) {
@@ -146,6 +252,10 @@ ui_term_backend_blit(Ui *ui)
 		memset(vt->cell_buffer.styles, 0, styles_size);
 		vt->flush_terminal = false;
 		vis_ui_vt100_immediate_clear();
+	} else {
+		// NOTE(rnp): let the terminal move content which only shifted vertically,
+		// possibly multiple regions e.g. when several windows scrolled
+		while (vis_ui_vt100_scroll(ui, buf));
 	}
 
 	///////////////////////
@@ -251,9 +361,16 @@ ui_term_backend_blit(Ui *ui)
 	// NOTE(rnp): maintain cursor position in case it gets queried through escape codes
 	vis_buffer_appendf(buf, "\x1b[%d;%dH", ui->cur_row + 1, ui->cur_col + 1);
 
+	if (ui->synchronized_output) {
+		str8 end = str8("\x1b[?2026l");
+		buffer_append(buf, end.data, end.length);
+	}
+
 	///////////////////////
 	// NOTE(rnp): blit
 	vis_ui_vt100_output((str8){.data = (u8 *)buf->data, .length = buf->length});
+	vt->bytes_written += buf->length;
+	vt->frames++;
 }
 
 VIS_INTERNAL void ui_term_backend_clear(Ui *ui) {}
@@ -304,7 +421,13 @@ ui_backend_init(Ui *ui, char *term)
 VIS_INTERNAL void
 vis_ui_backend_free(Ui *ui)
 {
+	VisVT100UI *vt = &ui->vt100;
 	ui_term_backend_suspend(ui);
-	if (ui->vt100.cell_buffer.size) munmap(ui->vt100.cell_buffer.cells, ui->vt100.cell_buffer.size);
-	buffer_release(&ui->vt100.output_buffer);
+	if (getenv("VIS_VT100_STATS")) {
+		fprintf(stderr, "vt100: %" PRIu64 " frames, %" PRIu64 " bytes (%" PRIu64 " per frame), %"
+		        PRIu64 " scrolled regions\n", vt->frames, vt->bytes_written,
+		        vt->frames ? vt->bytes_written / vt->frames : 0, vt->scrolls);
+	}
+	if (vt->cell_buffer.size) munmap(vt->cell_buffer.cells, vt->cell_buffer.size);
+	buffer_release(&vt->output_buffer);
 }
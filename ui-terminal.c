@@ -478,6 +478,9 @@ ui_draw(Vis *vis)
 {
 	Ui *tui = &vis->ui;
 	ui_arrange(vis, vis->ui.layout);
+	/* windows are drawn once the batch completes */
+	if (vis->batch)
+		return;
 	for (Win *win = vis->windows; win; win = win->next)
 		ui_window_draw(win);
 
@@ -635,7 +638,57 @@ vis_ui_termkey_reopen(Ui *ui, int fd, char *term)
 	return result;
 }
 
+VIS_INTERNAL void
+vis_ui_bracketed_paste(bool enable)
+{
+	if (isatty(STDERR_FILENO)) {
+		fputs(enable ? "\x1b[?2004h" : "\x1b[?2004l", stderr);
+		fflush(stderr);
+	}
+}
+
+VIS_INTERNAL bool
+vis_ui_paste_read(Ui *ui, Buffer *buf)
+{
+	/* the payload following CSI 200 ~ is terminated by CSI 201 ~ */
+	static const char end[] = "\x1b[201~";
+	const size_t end_len = sizeof(end) - 1;
+	TermKey *termkey = &ui->termkey;
+	for (;;) {
+		size_t len, keep = 0;
+		const unsigned char *data = termkey_peek_bytes(termkey, &len);
+		for (size_t i = 0; i < len; i++) {
+			size_t match = 0;
+			while (match < end_len && i + match < len && data[i + match] == end[match])
+				match++;
+			if (match == end_len) {
+				buffer_append(buf, data, i);
+				termkey_consume_bytes(termkey, i + end_len);
+				return true;
+			}
+			if (i + match == len) {
+				/* possibly incomplete terminator, wait for more data */
+				keep = match;
+				break;
+			}
+		}
+		if (!buffer_append(buf, data, len - keep))
+			return false;
+		termkey_consume_bytes(termkey, len - keep);
+
+		struct pollfd fd = {.fd = STDIN_FILENO, .events = POLLIN};
+		if (poll(&fd, 1, 1000) <= 0 || termkey_advisereadable(termkey) != TERMKEY_RES_AGAIN) {
+			/* terminator never arrived, return what was received so far */
+			data = termkey_peek_bytes(termkey, &len);
+			buffer_append(buf, data, len);
+			termkey_consume_bytes(termkey, len);
+			return false;
+		}
+	}
+}
+
 void ui_terminal_suspend(Ui *tui) {
+	vis_ui_bracketed_paste(false);
 	ui_term_backend_suspend(tui);
 	kill(0, SIGTSTP);
 }
@@ -665,6 +718,7 @@ vis_ui_getkey(Vis *vis, TermKeyKey *key)
 }
 
 void ui_terminal_save(Ui *tui, bool fscr) {
+	vis_ui_bracketed_paste(false);
 	ui_term_backend_save(tui, fscr);
 	termkey_stop(&tui->termkey);
 }
@@ -672,11 +726,13 @@ void ui_terminal_save(Ui *tui, bool fscr) {
 void ui_terminal_restore(Ui *tui) {
 	termkey_start(&tui->termkey, UI_TERMKEY_FLAGS);
 	ui_term_backend_restore(tui);
+	vis_ui_bracketed_paste(true);
 }
 
 VIS_INTERNAL void
 ui_terminal_free(Ui *tui)
 {
+	vis_ui_bracketed_paste(false);
 	vis_ui_backend_free(tui);
 	termkey_destroy(&tui->termkey);
 	if (tui->cell_buffer.size) munmap(tui->cell_buffer.cells, tui->cell_buffer.size);
@@ -711,6 +767,13 @@ ui_init(Ui *tui)
 	else        ui_terminal_free(tui);
 
 	if (result) {
+		/* query support for synchronized updates, the reply is handled as a key */
+		if (isatty(STDERR_FILENO)) {
+			fputs("\x1b[?2026$p", stderr);
+			fflush(stderr);
+		}
+		vis_ui_bracketed_paste(true);
+
 		VisCellStyle default_style = vis_ui_backend_style_default(tui);
 		for (u64 it = 0; it < countof(tui->styles); it++)
 			tui->styles[it] = default_style;
@@ -118,12 +118,18 @@ typedef struct {
 } VisCellBuffer;
 
 typedef struct {
+	// NOTE(rnp): cell front buffer, rows matching Ui::cell_buffer are not passed to curses
+	VisCellBuffer cell_buffer;
+
 	s16  *palette;
 	s16   color_pairs_max;
 	s16   color_pair_current;
 	s16   default_fg;
 	s16   default_bg;
 	s8    change_colors;
+
+	/* Indicates that the screen contents or color pairs changed behind the front buffer's back */
+	bool flush_terminal;
 } VisCursesUI;
 
 typedef struct {
@@ -131,6 +137,14 @@ typedef struct {
 	VisCellBuffer cell_buffer;
 	Buffer output_buffer;
 
+	/* per row hashes of the front and back buffer, used to detect scrolling */
+	u64 row_hashes[2 * UI_MAX_HEIGHT];
+
+	/* statistics reported on exit if VIS_VT100_STATS is set */
+	u64 frames;
+	u64 bytes_written;
+	u64 scrolls;
+
 	/* Indicates that the terminal contents may have changed externally */
 	bool flush_terminal;
 } VisVT100UI;
@@ -144,6 +158,7 @@ typedef struct {
 	enum UiLayout layout;      /* whether windows are displayed horizontally or vertically */
 	// TODO(rnp): cleanup usage of this
 	bool doupdate;             /* Whether to update the screen after refreshing contents */
+	bool synchronized_output;  /* whether the terminal supports synchronized updates (DEC mode 2026) */
 
 	str8 term;                 /* selected value for TERM (0 terminated) */
 
@@ -184,6 +199,9 @@ VIS_INTERNAL void ui_resize(Ui*);
 VIS_INTERNAL bool ui_window_init(Ui *, Win *, enum UiOption);
 
 VIS_INTERNAL bool vis_ui_getkey(Vis *, TermKeyKey *);
+VIS_INTERNAL void vis_ui_bracketed_paste(bool enable);
+/* read the content of a bracketed paste, returns false if it was not properly terminated */
+VIS_INTERNAL bool vis_ui_paste_read(Ui *, Buffer *);
 
 VIS_INTERNAL u16  vis_ui_style_push(Vis *);
 VIS_INTERNAL bool vis_ui_style_define(Vis *, u16 style_id, str8 style);
@@ -48,13 +48,207 @@ da_reserve_(Vis *vis, void *data, VisDACount *capacity, VisDACount needed, size_
 	return data;
 }
 
+/* Byte scanning kernels.
+ *
+ * Line counting, motions and the regex engine spend their time looking for
+ * single bytes in large chunks of text. On x86-64 the chunks are compared
+ * 16 bytes (SSE2) or, if the CPU supports it, 32 bytes (AVX2) at a time.
+ * Elsewhere 8 bytes are checked at once within a general purpose register
+ * (SWAR). The remaining bytes are handled one by one.
+ */
+typedef enum {
+	MemoryScan_Auto,
+	MemoryScan_Bytewise,
+	MemoryScan_SWAR,
+	MemoryScan_SSE2,
+	MemoryScan_AVX2,
+} MemoryScanLevel;
+
+/* kernels in use, determined on first use unless set beforehand (by tests) */
+static MemoryScanLevel memory_scan_level;
+
+static MemoryScanLevel
+memory_scan_level_get(void)
+{
+	if (likely(memory_scan_level != MemoryScan_Auto))
+		return memory_scan_level;
+#if MEMORY_SCAN_X86
+	memory_scan_level = __builtin_cpu_supports("avx2") ? MemoryScan_AVX2 : MemoryScan_SSE2;
+#elif defined(__clang__) || defined(__GNUC__)
+	memory_scan_level = MemoryScan_SWAR;
+#else
+	memory_scan_level = MemoryScan_Bytewise;
+#endif
+	return memory_scan_level;
+}
+
+#if defined(__clang__) || defined(__GNUC__)
+#define SWAR_LOW7 0x7F7F7F7F7F7F7F7Full
+#define SWAR_HIGH 0x8080808080808080ull
+#define SWAR_ONES 0x0101010101010101ull
+
+/* sets the high bit of exactly those bytes of word which equal byte */
+static inline u64
+swar_match(u64 word, u64 pattern)
+{
+	u64 x = word ^ pattern;
+	return ~(((x & SWAR_LOW7) + SWAR_LOW7) | x) & SWAR_HIGH;
+}
+
+static inline u64
+swar_load(const uint8_t *s)
+{
+	u64 word;
+	memcpy(&word, s, sizeof word);
+	return word;
+}
+
+/* index of the first/last byte flagged by swar_match in memory order */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define swar_first(m) (__builtin_ctzll(m) / 8)
+#define swar_last(m)  (7 - __builtin_clzll(m) / 8)
+#else
+#define swar_first(m) (__builtin_clzll(m) / 8)
+#define swar_last(m)  (7 - __builtin_ctzll(m) / 8)
+#endif
+
+static const uint8_t *
+memory_scan_forward_swar(const uint8_t *s, const uint8_t *end, uint8_t byte)
+{
+	u64 pattern = SWAR_ONES * byte;
+	for (; end - s >= 8; s += 8) {
+		u64 m = swar_match(swar_load(s), pattern);
+		if (m)
+			return s + swar_first(m);
+	}
+	return s;
+}
+
+static const uint8_t *
+memory_scan_reverse_swar(const uint8_t *start, const uint8_t *s, uint8_t byte)
+{
+	u64 pattern = SWAR_ONES * byte;
+	for (; s - start >= 8; s -= 8) {
+		u64 m = swar_match(swar_load(s - 8), pattern);
+		if (m)
+			return s - 8 + swar_last(m) + 1;
+	}
+	return s;
+}
+
+static u64
+memory_count_swar(const uint8_t **memory, const uint8_t *end, uint8_t byte)
+{
+	u64 pattern = SWAR_ONES * byte, result = 0;
+	const uint8_t *s = *memory;
+	for (; end - s >= 8; s += 8)
+		result += __builtin_popcountll(swar_match(swar_load(s), pattern));
+	*memory = s;
+	return result;
+}
+#endif
+
+#if MEMORY_SCAN_X86
+static const uint8_t *
+memory_scan_forward_sse2(const uint8_t *s, const uint8_t *end, uint8_t byte)
+{
+	__m128i pattern = _mm_set1_epi8((char)byte);
+	for (; end - s >= 16; s += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)s);
+		u32 m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+		if (m)
+			return s + __builtin_ctz(m);
+	}
+	return s;
+}
+
+static const uint8_t *
+memory_scan_reverse_sse2(const uint8_t *start, const uint8_t *s, uint8_t byte)
+{
+	__m128i pattern = _mm_set1_epi8((char)byte);
+	for (; s - start >= 16; s -= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(s - 16));
+		u32 m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+		if (m)
+			return s - 16 + (31 - __builtin_clz(m)) + 1;
+	}
+	return s;
+}
+
+static u64
+memory_count_sse2(const uint8_t **memory, const uint8_t *end, uint8_t byte)
+{
+	__m128i pattern = _mm_set1_epi8((char)byte);
+	const uint8_t *s = *memory;
+	u64 result = 0;
+	for (; end - s >= 16; s += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)s);
+		result += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern)));
+	}
+	*memory = s;
+	return result;
+}
+
+__attribute__((target("avx2"))) static const uint8_t *
+memory_scan_forward_avx2(const uint8_t *s, const uint8_t *end, uint8_t byte)
+{
+	__m256i pattern = _mm256_set1_epi8((char)byte);
+	for (; end - s >= 32; s += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)s);
+		u32 m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+		if (m)
+			return s + __builtin_ctz(m);
+	}
+	return s;
+}
+
+__attribute__((target("avx2"))) static const uint8_t *
+memory_scan_reverse_avx2(const uint8_t *start, const uint8_t *s, uint8_t byte)
+{
+	__m256i pattern = _mm256_set1_epi8((char)byte);
+	for (; s - start >= 32; s -= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(s - 32));
+		u32 m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+		if (m)
+			return s - 32 + (31 - __builtin_clz(m)) + 1;
+	}
+	return s;
+}
+
+__attribute__((target("avx2,popcnt"))) static u64
+memory_count_avx2(const uint8_t **memory, const uint8_t *end, uint8_t byte)
+{
+	__m256i pattern = _mm256_set1_epi8((char)byte);
+	const uint8_t *s = *memory;
+	u64 result = 0;
+	for (; end - s >= 32; s += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)s);
+		result += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern)));
+	}
+	*memory = s;
+	return result;
+}
+#endif
+
 static void *
 memory_scan_reverse(const void *memory, uint8_t byte, ptrdiff_t n)
 {
 	void *result = 0;
 	if (n > 0) {
-		const uint8_t *s = memory;
-		while (n) if (s[--n] == byte) { result = (void *)(s + n); break; }
+		const uint8_t *start = memory, *s = start + n;
+		switch (memory_scan_level_get()) {
+#if MEMORY_SCAN_X86
+		case MemoryScan_AVX2: s = memory_scan_reverse_avx2(start, s, byte); break;
+		case MemoryScan_SSE2: s = memory_scan_reverse_sse2(start, s, byte); break;
+#endif
+#if defined(__clang__) || defined(__GNUC__)
+		case MemoryScan_SWAR: s = memory_scan_reverse_swar(start, s, byte); break;
+#endif
+		default: break;
+		}
+		/* s is one past the match or the end of the remaining bytes */
+		n = s - start;
+		while (n) if (start[--n] == byte) { result = (void *)(start + n); break; }
 	}
 	return result;
 }
@@ -63,11 +257,43 @@ static void *
 memory_scan_forward(const void *memory, uint8_t byte, ptrdiff_t n)
 {
 	const uint8_t *s = memory, *end = s + n;
+	if (n > 0) {
+		switch (memory_scan_level_get()) {
+#if MEMORY_SCAN_X86
+		case MemoryScan_AVX2: s = memory_scan_forward_avx2(s, end, byte); break;
+		case MemoryScan_SSE2: s = memory_scan_forward_sse2(s, end, byte); break;
+#endif
+#if defined(__clang__) || defined(__GNUC__)
+		case MemoryScan_SWAR: s = memory_scan_forward_swar(s, end, byte); break;
+#endif
+		default: break;
+		}
+	}
 	while (s != end && *s != byte) s++;
 	void *result = (s != end) ? (void *)s : 0;
 	return result;
 }
 
+/* number of occurrences of byte within the n bytes at memory */
+static u64
+memory_count(const void *memory, uint8_t byte, ptrdiff_t n)
+{
+	const uint8_t *s = memory, *end = s + (n > 0 ? n : 0);
+	u64 result = 0;
+	switch (memory_scan_level_get()) {
+#if MEMORY_SCAN_X86
+	case MemoryScan_AVX2: result = memory_count_avx2(&s, end, byte); break;
+	case MemoryScan_SSE2: result = memory_count_sse2(&s, end, byte); break;
+#endif
+#if defined(__clang__) || defined(__GNUC__)
+	case MemoryScan_SWAR: result = memory_count_swar(&s, end, byte); break;
+#endif
+	default: break;
+	}
+	for (; s != end; s++) result += *s == byte;
+	return result;
+}
+
 static void
 memory_copy(void *restrict dest, void *restrict src, u64 n)
 {
@@ -44,9 +44,11 @@
 #include <limits.h>
 #include <locale.h>
 #include <poll.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <setjmp.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -66,6 +68,29 @@
 #include <unistd.h>
 #include <wchar.h>
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+/* splice(2) and vmsplice(2) are only declared with _GNU_SOURCE and invoked via
+ * syscall(2) instead, which in turn might be hidden by strict feature macros */
+long syscall(long number, ...);
+#ifndef SPLICE_F_MOVE
+#define SPLICE_F_MOVE 1
+#endif
+#ifndef SPLICE_F_NONBLOCK
+#define SPLICE_F_NONBLOCK 2
+#endif
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ 1031
+#endif
+#endif
+#if defined(__x86_64__) && (defined(__clang__) || defined(__GNUC__))
+#define MEMORY_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define MEMORY_SCAN_X86 0
+#endif
 #if CONFIG_ACL
 #include <sys/acl.h>
 #endif
@@ -95,6 +120,8 @@
 #define U64_MAX    (0xFFFFFFFFFFFFFFFFull)
 #define S64_MAX    (0x7FFFFFFFFFFFFFFFll)
 #define S32_MAX    (0x7FFFFFFFl)
+#define U32_MAX    (0xFFFFFFFFu)
+#define U16_MAX    (0xFFFFu)
 
 #define LENGTH(x)  ((int)(sizeof (x) / sizeof *(x)))
 #define MIN(a, b)  ((a) > (b) ? (b) : (a))
@@ -24,10 +24,102 @@ static str8 symbols_default[] = {
 	[SYNTAX_SYMBOL_EOF]      = str8_comp("~"),
 };
 
+/* Besides the linked list, selections form a treap ordered like the list,
+ * every node storing the size of its subtree. This allows to determine the
+ * number of a selection, to look it up by number and to find the insertion
+ * point of a new one in O(log n). */
+static uint32_t selection_priority(View *view) {
+	/* xorshift32 */
+	uint32_t x = view->selection_seed ? view->selection_seed : 2463534242;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return view->selection_seed = x;
+}
+
+static void selection_index_update(Selection *s) {
+	s->weight = 1;
+	if (s->left)
+		s->weight += s->left->weight;
+	if (s->right)
+		s->weight += s->right->weight;
+}
+
+static void selection_index_update_path(Selection *s) {
+	for (; s; s = s->parent)
+		selection_index_update(s);
+}
+
+/* replace s with c as child of s's parent */
+static void selection_index_replace(View *view, Selection *s, Selection *c) {
+	Selection *parent = s->parent;
+	if (!parent)
+		view->selection_root = c;
+	else if (parent->left == s)
+		parent->left = c;
+	else
+		parent->right = c;
+	if (c)
+		c->parent = parent;
+}
+
+/* rotate s above its parent, the in-order sequence is preserved */
+static void selection_index_rotate_up(View *view, Selection *s) {
+	Selection *parent = s->parent;
+	selection_index_replace(view, parent, s);
+	if (parent->left == s) {
+		parent->left = s->right;
+		if (s->right)
+			s->right->parent = parent;
+		s->right = parent;
+	} else {
+		parent->right = s->left;
+		if (s->left)
+			s->left->parent = parent;
+		s->left = parent;
+	}
+	parent->parent = s;
+	selection_index_update(parent);
+	selection_index_update(s);
+}
+
+/* insert s such that it directly follows prev, or as first node if prev is NULL */
+static void selection_index_insert(View *view, Selection *prev, Selection *s) {
+	Selection *parent;
+	s->left = s->right = NULL;
+	s->prio = selection_priority(view);
+	s->weight = 1;
+	if (!prev) {
+		for (parent = view->selection_root; parent && parent->left; parent = parent->left);
+		if (parent)
+			parent->left = s;
+		else
+			view->selection_root = s;
+	} else if (!prev->right) {
+		parent = prev;
+		parent->right = s;
+	} else {
+		for (parent = prev->right; parent->left; parent = parent->left);
+		parent->left = s;
+	}
+	s->parent = parent;
+	selection_index_update_path(parent);
+	while (s->parent && s->parent->prio < s->prio)
+		selection_index_rotate_up(view, s);
+}
+
+static void selection_index_remove(View *view, Selection *s) {
+	while (s->left && s->right)
+		selection_index_rotate_up(view, s->left->prio > s->right->prio ? s->left : s->right);
+	Selection *parent = s->parent;
+	selection_index_replace(view, s, s->left ? s->left : s->right);
+	selection_index_update_path(parent);
+	s->parent = s->left = s->right = NULL;
+}
+
 static void selection_free(Selection *s)
 {
-	for (Selection *after = s->next; after; after = after->next)
-		after->number--;
+	selection_index_remove(s->view, s);
 	if (s->prev)
 		s->prev->next = s->next;
 	if (s->next)
@@ -145,9 +237,8 @@ void view_tabwidth_set(View *view, int tabwidth) {
 	view_draw(view);
 }
 
-/* reset internal view data structures (cell matrix, line offsets etc.) */
-static void view_clear(View *view) {
-	memset(view->lines, 0, view->lines_size);
+/* update start of the visible area to account for changes before it */
+static void view_start_update(View *view) {
 	if (view->start != view->start_last) {
 		if (view->start == 0)
 			view->start_mark = EMARK;
@@ -164,6 +255,11 @@ static void view_clear(View *view) {
 	}
 
 	view->start_last = view->start;
+}
+
+/* reset internal view data structures (cell matrix, line offsets etc.) */
+static void view_clear(View *view) {
+	memset(view->lines, 0, view->lines_size);
 	view->topline = view->lines;
 	view->topline->lineno = view->large_file ? 1 : text_lineno_by_pos(view->text, view->start);
 	view->lastline = view->topline;
@@ -359,6 +455,233 @@ view_addch(View *view, VisCell *cell)
 	return view_add_cell(view, *cell);
 }
 
+/* The result of the last layout is kept around: when neither the text nor the
+ * visible area changed it is restored as is, which is the common case of
+ * cursor motions. Otherwise logical lines whose content did not change are
+ * copied over from the previous layout instead of being laid out again,
+ * provided that they follow a new line and hence start in the same state:
+ *
+ *   previous layout               new layout
+ *
+ *   row 0  |int main(void) {↵|    |int main(void) {↵|  <- first line always laid out
+ *   row 1  |»   puts("hello|  -> |»   puts("hello|  <- copied, lineno adjusted
+ *   row 2  |, world");↵     |  -> |, world");↵     |
+ *   row 3  |»   return 0;↵  |    |»   return 1;↵  |  <- content differs, laid out
+ *   row 4  |}↵              |  -> |}↵              |  <- copied
+ */
+static LayoutParams view_layout_params(View *view) {
+	Win *win = (Win *)((char *)view - offsetof(Win, view));
+	LayoutParams params = {
+		.width = view->width,
+		.tabwidth = view->tabwidth,
+		.wrapcolumn = view->wrapcolumn,
+		.style = win->vis->ui.styles[UI_STYLE_DEFAULT],
+		.whitespace = win->vis->ui.styles[UI_STYLE_WHITESPACE],
+	};
+	for (int i = 0; i < LENGTH(params.symbols); i++)
+		params.symbols[i] = view->symbols[i];
+	return params;
+}
+
+static bool view_layout_params_equal(const LayoutParams *a, const LayoutParams *b) {
+	if (a->width != b->width || a->tabwidth != b->tabwidth || a->wrapcolumn != b->wrapcolumn)
+		return false;
+	if (memcmp(&a->style, &b->style, sizeof(a->style)) ||
+	    memcmp(&a->whitespace, &b->whitespace, sizeof(a->whitespace)))
+		return false;
+	for (int i = 0; i < LENGTH(a->symbols); i++) {
+		if (a->symbols[i].data != b->symbols[i].data || a->symbols[i].length != b->symbols[i].length)
+			return false;
+	}
+	return true;
+}
+
+/* whether the lines of the last layout can be used for the current viewport as is */
+static bool view_layout_current(View *view) {
+	Layout *layout = &view->layout;
+	LayoutParams params = view_layout_params(view);
+	return layout->valid && layout->txt == view->text &&
+	       layout->version == text_version(view->text) &&
+	       layout->start == view->start && layout->height == view->height &&
+	       layout->large_file == view->large_file &&
+	       view_layout_params_equal(&layout->params, &params);
+}
+
+static Line *view_layout_line(View *view, Line *lines, int row) {
+	size_t line_size = sizeof(Line) + view->width * sizeof(VisCell);
+	return (Line*)(((char*)lines) + row * line_size);
+}
+
+static int view_layout_row(View *view, Line *line) {
+	size_t line_size = sizeof(Line) + view->width * sizeof(VisCell);
+	return ((char*)line - (char*)view->lines) / line_size;
+}
+
+typedef struct {
+	size_t start;   /* start of the current logical line, EPOS if it does not follow a new line */
+	int row;        /* screen line on which it starts */
+	VisDACount old; /* next logical line of the previous layout to consider for reuse */
+	bool reuse;     /* whether logical lines of the previous layout may be reused */
+} LayoutState;
+
+/* a new line at pos-1 was just laid out, record the logical line it terminates */
+static void view_layout_newline(View *view, LayoutState *state, size_t pos) {
+	Layout *layout = &view->layout;
+	if (state->start != EPOS) {
+		Win *win = (Win *)((char *)view - offsetof(Win, view));
+		int last = view->line ? view_layout_row(view, view->line) - 1 : view->height - 1;
+		LayoutLine *l = da_push(win->vis, layout->logical + 1);
+		l->off = state->start - view->start;
+		l->len = pos - state->start;
+		l->row = state->row;
+		l->rows = last - state->row + 1;
+	}
+	state->start = view->line ? pos : EPOS;
+	state->row = view->line ? view_layout_row(view, view->line) : view->height;
+}
+
+/* length of the logical line starting at pos including its new line, 0 if it
+ * is not terminated within max bytes */
+static size_t view_line_length(View *view, size_t pos, size_t max) {
+	size_t len = 0;
+	str8 chunk;
+	for (TextChunks c = text_chunks_get(view->text, text_range_new(pos, pos + max));
+	     text_chunks_next(&c, &chunk); len += chunk.length) {
+		const u8 *newline = memchr(chunk.data, '\n', chunk.length);
+		if (newline)
+			return len + (newline - chunk.data) + 1;
+	}
+	return 0;
+}
+
+/* whether the text starting at pos matches the content of a logical line of the previous layout */
+static bool view_layout_line_equal(View *view, const LayoutLine *l, size_t pos) {
+	const str8_list *text = &view->layout.text;
+	VisDACount i = l->chunk;
+	str8 old = str8_skip(text->data[i], l->chunk_off), chunk;
+	for (TextChunks c = text_chunks_get(view->text, text_range_new(pos, pos + l->len));
+	     text_chunks_next(&c, &chunk); ) {
+		while (chunk.length > 0) {
+			if (old.length == 0)
+				old = text->data[++i];
+			s64 len = MIN(chunk.length, old.length);
+			/* unchanged parts of the text still refer to the same storage */
+			if (chunk.data != old.data && memcmp(chunk.data, old.data, len))
+				return false;
+			chunk = str8_skip(chunk, len);
+			old = str8_skip(old, len);
+		}
+	}
+	return true;
+}
+
+/* try to display the logical line starting at pos by copying the screen lines
+ * of an identical one from the previous layout, returns the number of bytes used */
+static size_t view_layout_reuse(View *view, LayoutState *state, size_t pos) {
+	Layout *layout = &view->layout;
+	if (!state->reuse || state->start == EPOS)
+		return 0;
+	size_t max = 0;
+	for (VisDACount i = state->old; i < layout->logical[0].count; i++)
+		max = MAX(max, layout->logical[0].data[i].len);
+	size_t len = view_line_length(view, pos, max);
+	if (!len)
+		return 0;
+	for (VisDACount i = state->old; i < layout->logical[0].count; i++) {
+		LayoutLine *l = layout->logical[0].data + i;
+		if (l->len != len || l->chunk == -1 || state->row + l->rows > view->height ||
+		    !view_layout_line_equal(view, l, pos))
+			continue;
+		/* a zero width character following the new line would be merged into it */
+		char buf[8];
+		str8 next = {.data = (u8 *)buf, .length = text_bytes_get(view->text, pos + len, sizeof buf, buf)};
+		if (next.length > 0) {
+			VisCell cell = vis_cell_from_string(&next);
+			if (VisCellInvalid(cell) || cell.width == 0)
+				return 0;
+		}
+
+		size_t lineno = view->line->lineno;
+		Line *dst = view->line;
+		for (int r = 0; r < l->rows; r++, dst = dst->next) {
+			Line *src = view_layout_line(view, layout->lines, l->row + r);
+			dst->len = src->len;
+			dst->width = src->width;
+			dst->lineno = lineno;
+			memcpy(dst->cells, src->cells, view->width * sizeof(VisCell));
+			view->line = dst;
+		}
+		view->line = view->line->next;
+		if (view->line)
+			view->line->lineno = lineno + 1;
+		view->col = 0;
+		view->wrapcol = 0;
+		state->old = i + 1;
+		return len;
+	}
+	return 0;
+}
+
+/* remember the layout which was just completed. Instead of a copy of its text
+ * the slices of the underlying storage are kept, logical lines referring to
+ * content which might still change in place are excluded from being reused. */
+static void view_layout_save(View *view) {
+	Win *win = (Win *)((char *)view - offsetof(Win, view));
+	Layout *layout = &view->layout;
+	layout->decorated = false;
+	memcpy(layout->lines, view->lines, view->height * (sizeof(Line) + view->width * sizeof(VisCell)));
+	layout->text.count = 0;
+	str8 chunk;
+	for (TextChunks c = text_chunks_get(view->text, text_range_new(view->start, view->end));
+	     text_chunks_next(&c, &chunk); )
+		*da_push(win->vis, &layout->text) = chunk;
+	LayoutLineList logical = layout->logical[0];
+	layout->logical[0] = layout->logical[1];
+	layout->logical[1] = logical;
+
+	VisDACount i = 0;
+	size_t off = 0; /* offset of slice i from the start of the layout */
+	for (VisDACount j = 0; j < layout->logical[0].count; j++) {
+		LayoutLine *l = layout->logical[0].data + j;
+		for (; i < layout->text.count && off + layout->text.data[i].length <= l->off; i++)
+			off += layout->text.data[i].length;
+		l->chunk = i;
+		l->chunk_off = l->off - off;
+		size_t end = off;
+		for (VisDACount k = i; k < layout->text.count && end < l->off + l->len; k++) {
+			if (!text_chunk_stable(view->text, layout->text.data[k]))
+				l->chunk = -1;
+			end += layout->text.data[k].length;
+		}
+		if (end < l->off + l->len)
+			l->chunk = -1;
+	}
+
+	layout->params = view_layout_params(view);
+	layout->txt = view->text;
+	layout->version = text_version(view->text);
+	layout->start = view->start;
+	layout->end = view->end;
+	layout->height = view->height;
+	layout->large_file = view->large_file;
+	layout->valid = true;
+}
+
+/* undo any decorations applied since the last layout */
+static void view_layout_restore(View *view) {
+	Layout *layout = &view->layout;
+	if (!layout->decorated)
+		return;
+	memcpy(view->lines, layout->lines, view->height * (sizeof(Line) + view->width * sizeof(VisCell)));
+	layout->decorated = false;
+}
+
+/* whether drawing is deferred until a batch of commands completes, see vis_batch_begin */
+static bool view_batched(View *view) {
+	Win *win = (Win *)((char *)view - offsetof(Win, view));
+	return win->vis->batch > 0;
+}
+
 static void cursor_to(Selection *s, size_t pos) {
 	Text *txt = s->view->text;
 	s->cursor = text_mark_set(txt, pos);
@@ -375,8 +698,11 @@ static void cursor_to(Selection *s, size_t pos) {
 		}
 		return;
 	}
-	// TODO: minimize number of redraws
-	view_draw(s->view);
+	/* the layout is unaffected by cursor motions, only decorations need to be redrawn */
+	if (view_layout_current(s->view))
+		s->view->need_update = true;
+	else
+		view_draw(s->view);
 }
 
 bool view_coord_get(View *view, size_t pos, Line **retline, int *retrow, int *retcol) {
@@ -417,40 +743,79 @@ bool view_coord_get(View *view, size_t pos, Line **retline, int *retrow, int *re
 	return true;
 }
 
-/* redraw the complete with data starting from view->start bytes into the file.
+/* the text from pos onwards, at least need bytes of it if available. Usually
+ * this refers directly to the storage of the text, only characters spanning
+ * two chunks are assembled in the staging buffer. */
+static str8 view_text(View *view, size_t pos, s64 need) {
+	str8 result = {0};
+	TextChunks chunks = text_chunks_get(view->text, text_range_new(pos, text_size(view->text)));
+	if (text_chunks_next(&chunks, &result) && result.length < need) {
+		result.data = (u8 *)view->textbuf;
+		result.length = text_bytes_get(view->text, pos, sizeof view->textbuf, view->textbuf);
+	}
+	return result;
+}
+
+/* lay out the text starting from view->start bytes into the file.
  * stop once the screen is full, update view->end, view->lastline */
-VIS_INTERNAL void
-view_draw(View *view)
+static void view_layout(View *view)
 {
+	LayoutParams params = view_layout_params(view);
+	LayoutState state = {
+		.start = EPOS,
+		.reuse = view->layout.valid && view->layout.txt == view->text &&
+		         view_layout_params_equal(&view->layout.params, &params),
+	};
+	view->layout.logical[1].count = 0;
 	view_clear(view);
-	/* read a screenful of text considering each character as 4-byte UTF character*/
-	size_t size = view->width * view->height * 4;
-	/* current buffer to work with */
-	char *text = view->textbuf;
 	/* absolute position of character currently being added to display */
 	size_t pos = view->start;
 
-	str8 string = {.data = (u8 *)text, .length = text_bytes_get(view->text, view->start, size, text)};
+	str8 string = {0};
 	VisCell prev_cell = {0};
-	while (string.length > 0) {
-		VisCell cell = vis_cell_from_string(&string);
+	for (;;) {
+		VisCell cell;
+		if (string.length == 0) {
+			string = view_text(view, pos + prev_cell.file_byte_count, 1);
+			if (string.length == 0)
+				break;
+		}
+		cell = vis_cell_from_string(&string);
 
 		if VisCellInvalid(cell) {
-			// NOTE(rnp): needs more data. read another chunk into buffer.
-			string.length = text_bytes_get(view->text, pos + prev_cell.file_byte_count, size, text);
-			string.data   = (u8 *)text;
+			/* character continues in the next chunk of the text */
+			s64 partial = string.length;
+			string = view_text(view, pos + prev_cell.file_byte_count, partial + 1);
+			if (string.length > partial)
+				continue;
+			/* incomplete character at the end of the text */
+			cell = (VisCell){.data = {0xEF, 0xBF, 0xBD}, .data_length = 3,
+			                 .file_byte_count = string.length, .width = 1};
+			string = str8_skip(string, string.length);
+		}
+
+		if (cell.width == 0) {
+			u8 current   = prev_cell.data_length;
+			u8 remaining = countof(prev_cell.data) - current;
+			memory_copy(prev_cell.data + current, cell.data, MIN(remaining, cell.data_length));
+			prev_cell.file_byte_count += MIN(remaining, cell.data_length);
+			prev_cell.data_length     += MIN(remaining, cell.data_length);
 		} else {
-			if (cell.width == 0) {
-				u8 current   = prev_cell.data_length;
-				u8 remaining = countof(prev_cell.data) - current;
-				memory_copy(prev_cell.data + current, cell.data, MIN(remaining, cell.data_length));
-				prev_cell.file_byte_count += MIN(remaining, cell.data_length);
-				prev_cell.data_length     += MIN(remaining, cell.data_length);
-			} else {
-				if (prev_cell.file_byte_count && !view_addch(view, &prev_cell))
-					break;
-				pos += prev_cell.file_byte_count;
-				prev_cell = cell;
+			bool newline = prev_cell.data[0] == '\n';
+			if (prev_cell.file_byte_count && !view_addch(view, &prev_cell))
+				break;
+			pos += prev_cell.file_byte_count;
+			prev_cell = cell;
+			if (newline) {
+				size_t len;
+				view_layout_newline(view, &state, pos);
+				while ((len = view_layout_reuse(view, &state, pos))) {
+					/* the cell following the new line was already consumed, start over */
+					pos += len;
+					view_layout_newline(view, &state, pos);
+					string = (str8){0};
+					prev_cell = (VisCell){0};
+				}
 			}
 		}
 	}
@@ -484,6 +849,19 @@ view_draw(View *view)
 			view->line->cells[x] = blank;
 	}
 
+	view_layout_save(view);
+}
+
+/* redraw the complete view, reusing as much of the previous layout as possible */
+VIS_INTERNAL void
+view_draw(View *view)
+{
+	view_start_update(view);
+	if (view_layout_current(view))
+		view_layout_restore(view);
+	else
+		view_layout(view);
+
 	/* resync position of cursors within visible area */
 	for (Selection *s = view->selections; s; s = s->next) {
 		size_t pos = view_cursors_pos(s);
@@ -502,11 +880,14 @@ bool view_update(View *view) {
 	if (!view->need_update)
 		return false;
 
+	view_layout_restore(view);
 	VisCell blank = view_blank_cell(view);
 	for (Line *l = view->lastline->next; l; l = l->next) {
 		for (int x = 0; x < view->width; x++)
 			l->cells[x] = blank;
 	}
+	/* the caller is going to decorate the lines */
+	view->layout.decorated = true;
 	view->need_update = false;
 	return true;
 }
@@ -520,21 +901,19 @@ bool view_resize(View *view, int width, int height) {
 		view->need_update = true;
 		return true;
 	}
-	char *textbuf = malloc(width * height * 4 + 1);
-	if (!textbuf)
-		return false;
 	size_t lines_size = height * (sizeof(Line) + width * sizeof(VisCell));
 	if (lines_size > view->lines_size) {
 		Line *lines = realloc(view->lines, lines_size);
-		if (!lines) {
-			free(textbuf);
+		if (!lines)
 			return false;
-		}
 		view->lines = lines;
+		lines = realloc(view->layout.lines, lines_size);
+		if (!lines)
+			return false;
+		view->layout.lines = lines;
+		view->layout.valid = false;
 		view->lines_size = lines_size;
 	}
-	free(view->textbuf);
-	view->textbuf = textbuf;
 	view->width = width;
 	view->height = height;
 	view_draw(view);
@@ -546,13 +925,17 @@ void view_free(View *view) {
 		return;
 	while (view->selections)
 		selection_free(view->selections);
-	free(view->textbuf);
 	free(view->lines);
 	free(view->breakat);
+	free(view->layout.lines);
+	da_release(&view->layout.text);
+	da_release(view->layout.logical + 0);
+	da_release(view->layout.logical + 1);
 }
 
 void view_reload(View *view, Text *text) {
 	view->text = text;
+	view->layout.valid = false;
 	view_selections_clear_all(view);
 	view_cursors_to(view->selection, 0);
 }
@@ -784,7 +1167,7 @@ size_t view_line_up(Selection *sel) {
 	size_t pos = text_line_up(sel->view->text, sel->pos);
 	bool offscreen = view->selection == sel && pos < view->start;
 	view_cursors_to(sel, pos);
-	if (offscreen)
+	if (offscreen && !view_batched(view))
 		view_redraw_top(view);
 	if (sel->line)
 		cursor_set(sel, sel->line, lastcol);
@@ -800,7 +1183,7 @@ size_t view_line_down(Selection *sel) {
 	size_t pos = text_line_down(sel->view->text, sel->pos);
 	bool offscreen = view->selection == sel && pos > view->end;
 	view_cursors_to(sel, pos);
-	if (offscreen)
+	if (offscreen && !view_batched(view))
 		view_redraw_bottom(view);
 	if (sel->line)
 		cursor_set(sel, sel->line, lastcol);
@@ -886,6 +1269,7 @@ bool view_breakat_set(View *view, const char *breakat) {
 		return false;
 	free(view->breakat);
 	view->breakat = copy;
+	view->layout.valid = false;
 	return true;
 }
 
@@ -909,6 +1293,7 @@ static Selection *selections_new(View *view, size_t pos, bool force) {
 		view->selection_latest = s;
 		view->selections = s;
 		view->selection_count = 1;
+		selection_index_insert(view, NULL, s);
 		return s;
 	}
 
@@ -918,38 +1303,35 @@ static Selection *selections_new(View *view, size_t pos, bool force) {
 	if (pos == cur) {
 		prev = latest;
 		next = prev->next;
-	} else if (pos > cur) {
-		prev = latest;
-		for (next = prev->next; next; prev = next, next = next->next) {
-			cur = view_cursors_pos(next);
-			if (pos <= cur)
-				break;
-		}
-	} else if (pos < cur) {
-		next = latest;
-		for (prev = next->prev; prev; next = prev, prev = prev->prev) {
-			cur = view_cursors_pos(prev);
-			if (pos >= cur)
-				break;
+	} else {
+		/* find the first selection not located before pos */
+		for (Selection *node = view->selection_root; node; ) {
+			size_t node_pos = view_cursors_pos(node);
+			if (pos <= node_pos) {
+				next = node;
+				cur = node_pos;
+				node = node->left;
+			} else {
+				prev = node;
+				node = node->right;
+			}
 		}
+		if (!next)
+			cur = EPOS;
 	}
 
 	if (pos == cur && !force)
 		goto err;
 
-	for (Selection *after = next; after; after = after->next)
-		after->number++;
-
 	s->prev = prev;
 	s->next = next;
 	if (next)
 		next->prev = s;
-	if (prev) {
+	if (prev)
 		prev->next = s;
-		s->number = prev->number + 1;
-	} else {
+	else
 		view->selections = s;
-	}
+	selection_index_insert(view, prev, s);
 	view->selection_latest = s;
 	view->selection_count++;
 	view_selections_dispose(view->selection_dead);
@@ -969,7 +1351,28 @@ Selection *view_selections_new_force(View *view, size_t pos) {
 }
 
 int view_selections_number(Selection *sel) {
-	return sel->number;
+	int number = sel->left ? sel->left->weight : 0;
+	for (; sel->parent; sel = sel->parent) {
+		Selection *parent = sel->parent;
+		if (parent->right == sel)
+			number += 1 + (parent->left ? parent->left->weight : 0);
+	}
+	return number;
+}
+
+Selection *view_selections_nth(View *view, int number) {
+	for (Selection *s = view->selection_root; s; ) {
+		int left = s->left ? s->left->weight : 0;
+		if (number < left) {
+			s = s->left;
+		} else if (number == left) {
+			return s;
+		} else {
+			number -= left + 1;
+			s = s->right;
+		}
+	}
+	return NULL;
 }
 
 int view_selections_column_count(View *view) {
@@ -1116,9 +1519,17 @@ int view_cursors_cell_set(Selection *s, int cell) {
 
 void view_cursors_scroll_to(Selection *s, size_t pos) {
 	View *view = s->view;
-	if (view->selection == s) {
+	if (view->selection == s)
 		view_draw(view);
+	/* when batched, view_cursors_to jumps to the position instead of scrolling */
+	if (view->selection == s && !view_batched(view)) {
 		while (pos < view->start && view_viewport_up(view, 1));
+		/* move close to far away positions at once instead of scrolling line by line */
+		if (pos > view->end && pos - view->end > 2 * (view->end - view->start)) {
+			view->start = text_line_begin(view->text, pos);
+			view_draw(view);
+			view_viewport_up(view, view->height - 1);
+		}
 		while (pos > view->end && view_viewport_down(view, 1));
 	}
 	view_cursors_to(s, pos);
@@ -1141,6 +1552,13 @@ void view_cursors_to(Selection *s, size_t pos) {
 			view_draw(view);
 		}
 
+		if ((pos < view->start || pos > view->end) && view_batched(view)) {
+			/* the viewport is adjusted once the batch completes, no need to scroll */
+			view->start = text_line_begin(view->text, pos);
+			view_draw(view);
+			view->batch_jumped = true;
+		}
+
 		if (pos < view->start || pos > view->end) {
 			view->start = pos;
 			view_viewport_up(view, view->height / 2);
@@ -1227,15 +1645,40 @@ bool view_selections_set(Selection *s, Filerange r)
 	return true;
 }
 
-Filerange view_regions_restore(View *view, SelectionRegion s)
+FilerangeList view_regions_restore(Vis *vis, View *view, SelectionRegionList *regions)
 {
+	FilerangeList result = {0};
+	if (!regions->count)
+		return result;
+
+	/* resolve all marks in one batch, regions are usually stored
+	 * in order and thus mostly share the same pieces */
 	Text *txt = view->text;
-	size_t anchor = text_mark_get(txt, s.anchor);
-	size_t cursor = text_mark_get(txt, s.cursor);
-	Filerange sel = text_range_new(anchor, cursor);
-	if (text_range_valid(sel))
-		sel.end = text_char_next(txt, sel.end);
-	return sel;
+	size_t count = 2 * (size_t)regions->count;
+	Mark *marks = malloc(count * sizeof *marks);
+	size_t *pos = malloc(count * sizeof *pos);
+	if (!marks || !pos) {
+		free(marks);
+		free(pos);
+		vis_oom(vis);
+	}
+	for (VisDACount i = 0; i < regions->count; i++) {
+		marks[2*i] = regions->data[i].anchor;
+		marks[2*i+1] = regions->data[i].cursor;
+	}
+	text_marks_get(txt, marks, pos, count);
+
+	da_reserve(vis, &result, regions->count);
+	for (VisDACount i = 0; i < regions->count; i++) {
+		Filerange sel = text_range_new(pos[2*i], pos[2*i+1]);
+		if (text_range_valid(sel)) {
+			sel.end = text_char_next(txt, sel.end);
+			*da_push(vis, &result) = sel;
+		}
+	}
+	free(marks);
+	free(pos);
+	return result;
 }
 
 bool view_regions_save(View *view, Filerange r, SelectionRegion *s)
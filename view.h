@@ -33,6 +33,41 @@ struct Line {               /* a line on the screen, *not* in the file */
 	VisCell cells[];    /* view->width cells storing information about the displayed characters */
 };
 
+typedef struct {
+	size_t off;         /* offset of the logical line from the start of the layout */
+	VisDACount chunk;   /* slice of the layout text it starts in, -1 if its content may change */
+	size_t chunk_off;   /* offset of its start within that slice */
+	size_t len;         /* bytes displayed by its screen lines, including the new line */
+	int row;            /* first screen line used to display it */
+	int rows;           /* number of screen lines used to display it */
+} LayoutLine;
+
+typedef struct {
+	LayoutLine *data;
+	VisDACount  count;
+	VisDACount  capacity;
+} LayoutLineList;
+
+typedef struct {
+	int width, tabwidth, wrapcolumn;
+	str8 symbols[SYNTAX_SYMBOL_LAST];
+	VisCellStyle style, whitespace;
+} LayoutParams;     /* everything besides the text which determines how a line is displayed */
+
+typedef struct {
+	Line *lines;        /* copy of view->lines as laid out, before any decorations were applied */
+	str8_list text;     /* slices of the text content of the layout i.e. [start, end) */
+	LayoutLineList logical[2]; /* complete logical lines of the current and the next layout */
+	LayoutParams params;
+	Text *txt;          /* text, version, viewport and height used for the current layout */
+	size_t version;
+	size_t start, end;
+	int height;
+	bool large_file;
+	bool valid;         /* whether the current layout may be reused at all */
+	bool decorated;     /* whether view->lines has to be restored from lines */
+} Layout;
+
 struct View;
 typedef struct Selection {
 	Mark cursor;            /* other selection endpoint where it changes */
@@ -43,14 +78,22 @@ typedef struct Selection {
 	int lastcol;            /* remembered column used when moving across lines */
 	Line *line;             /* screen line on which cursor currently resides */
 	int generation;         /* used to filter out newly created cursors during iteration */
-	int number;             /* how many cursors are located before this one */
 	struct View *view;      /* associated view to which this cursor belongs */
 	struct Selection *prev, *next; /* previous/next cursors ordered by location at creation time */
+	struct Selection *parent, *left, *right; /* node of the tree over all cursors, ordered like the list */
+	int weight;             /* number of cursors in the subtree rooted at this one */
+	uint32_t prio;          /* heap priority within the tree */
 } Selection;
 
+typedef struct {
+	Selection  **data;
+	VisDACount   count;
+	VisDACount   capacity;
+} SelectionList;
+
 typedef struct View {
 	Text *text;         /* underlying text management */
-	char *textbuf;      /* scratch buffer used for drawing */
+	char textbuf[64];   /* characters spanning chunks of the text are assembled here */
 	int width, height;  /* size of display area */
 	size_t start, end;  /* currently displayed area [start, end] in bytes from the start of the file */
 	size_t start_last;  /* previously used start of visible area, used to update the mark */
@@ -69,14 +112,18 @@ typedef struct View {
 	str8 symbols[SYNTAX_SYMBOL_LAST]; /* symbols to use for white spaces etc */
 	int tabwidth;       /* how many spaces should be used to display a tab character */
 	Selection *selections;    /* all cursors currently active */
+	Selection *selection_root; /* root of the tree indexing all cursors by number */
+	uint32_t selection_seed;  /* state of the priority generator for the tree */
 	int selection_generation; /* used to filter out newly created cursors during iteration */
 	bool need_update;   /* whether view has been redrawn */
+	bool batch_jumped;  /* viewport followed the primary cursor while drawing was deferred */
 	bool large_file;    /* optimize for displaying large files */
 	int colorcolumn;
 	char *breakat;  /* characters which might cause a word wrap */
 	int wrapcolumn; /* wrap lines at minimum of window width and wrapcolumn (if != 0) */
 	int wrapcol;    /* used while drawing view content, column where word wrap might happen */
 	bool prevch_breakat; /* used while drawing view content, previous char is part of breakat */
+	Layout layout;  /* result of the last layout, used to avoid redoing it for unchanged lines */
 } View;
 
 /**
@@ -209,6 +256,8 @@ VIS_INTERNAL Selection *view_selections_next(Selection*);
  * @endrst
  */
 VIS_INTERNAL int view_selections_number(Selection*);
+/** Get the selection with the given zero based number, or ``NULL``. */
+VIS_INTERNAL Selection *view_selections_nth(View*, int number);
 /** Get maximal number of selections on a single line. */
 VIS_INTERNAL int view_selections_column_count(View*);
 /**
@@ -337,7 +386,7 @@ VIS_INTERNAL size_t view_cursor_get(View*);
  * @defgroup view_save Selection State
  * @{
  */
-VIS_INTERNAL Filerange view_regions_restore(View*, SelectionRegion);
+VIS_INTERNAL FilerangeList view_regions_restore(Vis*, View*, SelectionRegionList*);
 VIS_INTERNAL bool view_regions_save(View*, Filerange, SelectionRegion*);
 /**
  * @}
@@ -18,7 +18,46 @@
  *
  * if no binding is found, mode->input(...) is called and the user entered
  * keys are passed as argument. this is used to change the document content.
+ *
+ * to avoid searching the tree for every key, the bindings reachable from a
+ * mode (including the window local ones) are compiled into a KeyTable: an
+ * automaton whose transitions are keyed by symbolic keys. it is rebuilt
+ * whenever Vis::bindings_version indicates that some mapping changed.
  */
+typedef struct {
+	const KeyBinding *binding; /* binding triggered by the keys leading to this state */
+	u32 next;                  /* number of transitions leaving this state, input is ambiguous if non-zero */
+	u16 binding_level;         /* position of the mode providing binding in the search order */
+	u16 prefix_level;          /* position of the first mode with a longer binding in the search order */
+} KeyState;
+
+typedef struct {
+	u64 hash;
+	u32 from, to;              /* states connected by this transition */
+	u32 key, key_length;       /* symbolic key, stored in KeyTable::keys */
+} KeyTransition;
+
+typedef struct {
+	KeyState *data;
+	VisDACount count;
+	VisDACount capacity;
+} KeyStateList;
+
+typedef struct {
+	KeyTransition *data;
+	VisDACount count;
+	VisDACount capacity;
+} KeyTransitionList;
+
+typedef struct {
+	KeyStateList states;           /* states[0] is the initial state */
+	KeyTransitionList transitions;
+	u32 *slots;                    /* open addressing hash table of transition indices + 1 */
+	u32 slot_count;                /* power of two */
+	Buffer keys;                   /* symbolic keys of all transitions */
+	u32 version;                   /* Vis::bindings_version the table was compiled from */
+} KeyTable;
+
 typedef struct Mode Mode;
 struct Mode {
 	enum VisMode id;
@@ -33,6 +72,7 @@ struct Mode {
 	void (*idle)(Vis*);                 /* called whenever a certain idle time i.e. without any user input elapsed */
 	time_t idle_timeout;                /* idle time in seconds after which the registered function will be called */
 	bool visual;                        /* whether text selection is possible in this mode */
+	KeyTable keys;                      /* compiled bindings of this mode and its parents */
 };
 
 enum PromptState {
@@ -133,6 +173,31 @@ typedef struct {
 	enum SamError error;  /* non-zero in case something went wrong */
 } Transcript;
 
+typedef struct {
+	size_t start, end;  /* token range [start, end) in bytes */
+	u16 style;          /* style id or HIGHLIGHT_UNSTYLED */
+	bool line_start;    /* whether the token starts a line i.e. lexing can be resumed there */
+} HighlightToken;
+
+#define HIGHLIGHT_UNSTYLED ((u16)-1)
+
+typedef struct { HighlightToken *data; VisDACount count; VisDACount capacity; } HighlightTokenList;
+
+typedef struct { /* incrementally maintained syntax highlighting of a window */
+	const void *lexer;          /* identity of the lexer which produced the tokens */
+	Text *txt;                  /* text the tokens refer to */
+	size_t version;             /* text_version(txt) for which the tokens are valid */
+	size_t start, end;          /* lexed range [start, end), start is at the beginning of a line */
+	Mark start_mark, end_mark;  /* used to relocate the lexed range after modifications */
+	HighlightTokenList tokens;  /* tokens covering [start, end) */
+	HighlightTokenList tail;    /* tokens after a modification which might be reused */
+	size_t damage;              /* end of the modification, tail tokens are only reused past it */
+	char *text;                 /* copy of [start, end) used to locate modifications */
+	size_t text_size;
+	char *data;                 /* scratch buffer passed to the lexer */
+	size_t data_size;
+} Highlight;
+
 struct File { /* shared state among windows displaying the same file */
 	str8  name;                      /* suffix slice of filepath without working directory */
 	str8  filepath;                  /* file name used when loading/saving (0 terminated) */
@@ -163,6 +228,7 @@ struct Win {
 	Win *parent;            /* window which was active when showing the command prompt */
 	Mode *parent_mode;      /* mode which was active when showing the command prompt */
 	Win *prev, *next;       /* neighbouring windows */
+	Highlight highlight;    /* cached syntax highlighting tokens */
 
 	/* NOTE: Selection Jump Cache
 	 * Anytime the selection jumps the previous set of selections gets
@@ -178,6 +244,82 @@ struct Win {
 	enum VisMode        mark_set_lru_modes[VIS_MARK_SET_LRU_COUNT];
 };
 
+/* maximal number of ready event sources reported by a single wait */
+#define VIS_EVENT_READY_MAX 64
+
+typedef enum {
+	VisEventSourceFlag_Read  = 1 << 0,
+	VisEventSourceFlag_Write = 1 << 1,
+	/* only reported again after the source was read or written until EAGAIN */
+	VisEventSourceFlag_Edge  = 1 << 2,
+} VisEventSourceFlags;
+
+typedef struct VisTimer VisTimer;
+typedef void VisTimerFunction(Vis*, const VisTimer*);
+struct VisTimer {
+	u64 deadline;              /* CLOCK_MONOTONIC milliseconds at which func is called */
+	u32 interval;              /* milliseconds between repetitions, 0 for a single shot */
+	u32 id;
+	VisTimerFunction *func;
+	void *context;
+};
+
+typedef struct {
+	VisTimer *data;            /* binary heap ordered by deadline */
+	VisDACount count;
+	VisDACount capacity;
+} VisTimerList;
+
+#if !defined(__linux__)
+typedef struct {
+	int fd;
+	VisEventSourceFlags flags;
+	void *data;
+} VisEventSource;
+
+typedef struct {
+	VisEventSource *data;
+	VisDACount count;
+	VisDACount capacity;
+} VisEventSourceList;
+#endif
+
+typedef struct {
+#if defined(__linux__)
+	int epoll;                 /* epoll instance watching all event sources */
+#else
+	VisEventSourceList sources;
+#endif
+	VisTimerList timers;
+	u32 timer_id;              /* id of the most recently added timer */
+	u64 idle;                  /* when the idle function of the current mode is due, 0 if not pending */
+} VisEventLoop;
+
+/* a `|` command running in the background, see vis-filter.c */
+typedef struct {
+	File *file;                /* file whose range gets replaced, NULL if no filter is running */
+	Filerange range;           /* range passed to stdin and replaced by stdout */
+	size_t written;            /* number of bytes of the range written so far */
+	size_t version;            /* text version the range refers to */
+	pid_t pid;
+	int inpfd, outfd, errfd;   /* pipes to the command, -1 once closed */
+	TextInput out;             /* output stored in the text until the command terminates */
+	Buffer err;
+	u32 progress;              /* id of the timer showing the progress indicator */
+	bool reported;             /* whether the progress indicator was shown */
+} VisFilter;
+
+/* a `:w` committed by a worker thread in the background, see vis-save.c */
+typedef struct {
+	File *file;                /* file being saved, NULL if no save is running */
+	str8 path;                 /* absolute path the file is saved to */
+	bool update_stat;          /* whether path refers to the file as loaded */
+	TextSave ctx;              /* snapshot of the text, owned by the thread until it completed */
+	pthread_t thread;
+	int fd, done;              /* pipe whose write end the thread closes once it completed */
+	int error;                 /* errno value of the failure, 0 on success */
+} VisSave;
+
 struct Vis {
 	File *files;                         /* all files currently managed by this editor instance */
 	File *prompt_file;                   /* special internal file used to store :,/,? prompt */
@@ -189,6 +331,7 @@ struct Vis {
 	Register registers[VIS_REG_INVALID]; /* registers used for text manipulations yank/put etc. and macros */
 	Macro *recording, *last_recording;   /* currently (if non NULL) and least recently recorded macro */
 	const Macro *replaying;              /* macro currently being replayed */
+	int batch;                           /* nesting level of replays whose drawing is deferred */
 	Macro *macro_operator;               /* special macro used to repeat certain operators */
 	Mode *mode_before_prompt;            /* user mode which was active before entering prompt */
 	char search_char[8];                 /* last used character to search for via 'f', 'F', 't', 'T' */
@@ -196,16 +339,20 @@ struct Vis {
 	int search_direction;                /* used for `n` and `N` */
 	VisTextLoadMethod load_method;       /* how existing files should be loaded */
 	enum PromptState prompt_state;       /* needed for determining primary cursor's position */
+	bool prompt_interactive;             /* whether the command being executed was entered at the prompt, no keys queued behind it */
 	bool autoindent;                     /* whether indentation should be copied from previous line on newline */
 	bool change_colors;                  /* whether to adjust 256 color palette for true colors */
 	bool ignorecase;                     /* whether to ignore case when searching */
 	bool keymap_disabled;                /* ignore key map for next key press, gets automatically re-enabled */
 	int  escape_delay;                   /* ms to wait for new input when partial escape sequence is detected */
+	int  maxfps;                         /* upper bound of frames drawn per second, 0 for no limit */
+	struct timespec frame_last;          /* when the last frame was drawn, used to coalesce redraws */
 	char *shell;                         /* shell used to launch external commands */
 	Map *cmds;                           /* ":"-commands, used for unique prefix queries */
 	Map *usercmds;                       /* user registered ":"-commands */
 	Map *options;                        /* ":set"-options */
 	Map *keymap;                         /* key translation before any bindings are matched */
+	u32 bindings_version;                /* incremented whenever key bindings change, see KeyTable */
 	char key[VIS_KEY_LENGTH_MAX];        /* last pressed key as reported from the UI */
 	char key_current[VIS_KEY_LENGTH_MAX];/* current key being processed by the input queue */
 	char key_prev[VIS_KEY_LENGTH_MAX];   /* previous key which was processed by the input queue */
@@ -223,6 +370,10 @@ struct Vis {
 	volatile sig_atomic_t need_resize;   /* need to resize UI (SIGWINCH occurred) */
 	volatile sig_atomic_t resume;        /* need to resume UI (SIGCONT occurred) */
 	volatile sig_atomic_t terminate;     /* need to terminate we were being killed by SIGTERM */
+	volatile sig_atomic_t sigchld;       /* a child process terminated (SIGCHLD occurred) */
+	VisEventLoop loop;                   /* event sources and timers the main loop waits for */
+	VisFilter filter;                    /* filter command running in the background */
+	VisSave save;                        /* save running in the background */
 	Map *actions;                        /* registered editor actions / special keys commands */
 
 	struct {
@@ -301,14 +452,27 @@ VIS_INTERNAL void macro_operator_stop(Vis *vis);
 VIS_INTERNAL void macro_operator_record(Vis *vis);
 
 VIS_INTERNAL void vis_do(Vis *vis);
+VIS_INTERNAL void vis_batch_begin(Vis *vis);
+VIS_INTERNAL void vis_batch_end(Vis *vis);
 VIS_INTERNAL void action_reset(Action*);
 VIS_INTERNAL size_t vis_text_insert_nl(Vis*, Text*, size_t pos);
 
 VIS_INTERNAL Mode *mode_get(Vis*, enum VisMode);
+VIS_INTERNAL KeyTable *vis_keys_table(Vis*);
+VIS_INTERNAL u32 key_table_next(const KeyTable*, u32 state, const char *key, size_t len);
+VIS_INTERNAL void key_table_free(KeyTable*);
 VIS_INTERNAL void mode_set(Vis *vis, Mode *new_mode);
 VIS_INTERNAL Macro *macro_get(Vis *vis, enum VisRegister);
 
 VIS_INTERNAL Win *window_new_file(Vis*, File*, enum UiOption);
+
+/* Lex len bytes of data starting at a line beginning and append the resulting
+ * tokens. Their end is relative to data, their start is filled in afterwards. */
+typedef bool HighlightLex(Vis*, void *context, const char *data, size_t len, HighlightTokenList *tokens);
+/* style the viewport using tokens for the surrounding horizon bytes, lexing only what changed */
+VIS_INTERNAL void vis_highlight(Win*, const void *lexer, size_t horizon, HighlightLex*, void *context);
+VIS_INTERNAL void vis_highlight_reset(Win*);
+VIS_INTERNAL void vis_highlight_free(Win*);
 VIS_INTERNAL void window_selection_save(Win *win);
 VIS_INTERNAL void window_status_update(Vis *vis, Win *win);
 
@@ -325,6 +489,27 @@ VIS_INTERNAL bool register_slot_put_range(Vis*, Register*, size_t slot, Text*, F
 VIS_INTERNAL size_t vis_register_count(Vis*, Register*);
 VIS_INTERNAL bool register_resize(Register*, VisDACount count);
 
+VIS_INTERNAL u64  vis_time_ms(void);
+VIS_INTERNAL bool vis_event_loop_init(Vis*);
+VIS_INTERNAL void vis_event_loop_free(Vis*);
+VIS_INTERNAL bool vis_event_source_add(Vis*, int fd, void *data, VisEventSourceFlags);
+VIS_INTERNAL void vis_event_source_remove(Vis*, int fd);
+VIS_INTERNAL int  vis_event_loop_wait(Vis*, void *ready[VIS_EVENT_READY_MAX], int timeout, const sigset_t *sigmask);
+VIS_INTERNAL int  vis_event_loop_timeout(Vis*);
+VIS_INTERNAL void vis_event_loop_expire(Vis*);
+VIS_INTERNAL u32  vis_timer_add(Vis*, u32 timeout, u32 interval, VisTimerFunction*, void *context);
+VIS_INTERNAL bool vis_timer_cancel(Vis*, u32 id);
+
+VIS_INTERNAL bool vis_filter_start(Vis*, File*, Filerange, const char *argv[]);
+VIS_INTERNAL bool vis_filter_cancel(Vis*);
+VIS_INTERNAL void vis_filter_io(Vis*);
+VIS_INTERNAL void vis_filter_tick(Vis*);
+
+VIS_INTERNAL void vis_file_saved(Vis*, File*, str8 path, bool update_stat);
+VIS_INTERNAL bool vis_save_start(Vis*, File*, TextSave*, const Filerange *ranges, size_t count,
+                                 str8 path, bool update_stat);
+VIS_INTERNAL void vis_save_wait(Vis*);
+
 #define vis_oom(vis) longjmp((vis)->oom_jmp_buf, 1)
 
 #endif
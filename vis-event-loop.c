@@ -0,0 +1,233 @@
+/* Main loop event sources and timers.
+ *
+ * vis_run waits for input from the terminal and from the pipes of processes
+ * started by vis_process_communicate, for timers to expire and for signals,
+ * all at once. On Linux the file descriptors are registered with an epoll
+ * instance, hence the cost of a wait does not depend on how many of them are
+ * watched. Elsewhere pselect(2) serves as fallback.
+ *
+ * Timers are kept in a binary heap ordered by their deadline. All times are
+ * milliseconds of CLOCK_MONOTONIC.
+ */
+
+VIS_INTERNAL u64
+vis_time_ms(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+VIS_INTERNAL bool
+vis_event_loop_init(Vis *vis)
+{
+#if defined(__linux__)
+	vis->loop.epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (vis->loop.epoll == -1)
+		return false;
+#endif
+	return vis_event_source_add(vis, STDIN_FILENO, &vis->ui, VisEventSourceFlag_Read);
+}
+
+VIS_INTERNAL void
+vis_event_loop_free(Vis *vis)
+{
+	VisEventLoop *loop = &vis->loop;
+#if defined(__linux__)
+	if (loop->epoll > 0)
+		close(loop->epoll);
+#else
+	da_release(&loop->sources);
+#endif
+	da_release(&loop->timers);
+}
+
+/* watch fd for becoming readable or writable, data identifies it once it is ready */
+VIS_INTERNAL bool
+vis_event_source_add(Vis *vis, int fd, void *data, VisEventSourceFlags flags)
+{
+#if defined(__linux__)
+	struct epoll_event event = {
+		.events = (flags & VisEventSourceFlag_Read  ? EPOLLIN  : 0) |
+		          (flags & VisEventSourceFlag_Write ? EPOLLOUT : 0) |
+		          (flags & VisEventSourceFlag_Edge  ? EPOLLET  : 0),
+		.data.ptr = data,
+	};
+	return epoll_ctl(vis->loop.epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+#else
+	if (fd >= FD_SETSIZE)
+		return false;
+	*da_push(vis, &vis->loop.sources) = (VisEventSource){.fd = fd, .flags = flags, .data = data};
+	return true;
+#endif
+}
+
+/* needs to be called before fd is closed, other processes might share it */
+VIS_INTERNAL void
+vis_event_source_remove(Vis *vis, int fd)
+{
+#if defined(__linux__)
+	struct epoll_event event = {0};
+	epoll_ctl(vis->loop.epoll, EPOLL_CTL_DEL, fd, &event);
+#else
+	VisEventSourceList *sources = &vis->loop.sources;
+	for (VisDACount i = 0; i < sources->count; i++) {
+		if (sources->data[i].fd == fd) {
+			da_unordered_remove(sources, i);
+			break;
+		}
+	}
+#endif
+}
+
+/* Wait until a source becomes ready, a signal not blocked by sigmask arrives or
+ * timeout milliseconds (-1 for no limit) elapsed. Stores the data of at most
+ * VIS_EVENT_READY_MAX ready sources in ready and returns their number, -1 on error. */
+VIS_INTERNAL int
+vis_event_loop_wait(Vis *vis, void *ready[VIS_EVENT_READY_MAX], int timeout, const sigset_t *sigmask)
+{
+#if defined(__linux__)
+	struct epoll_event events[VIS_EVENT_READY_MAX];
+	int count = epoll_pwait(vis->loop.epoll, events, VIS_EVENT_READY_MAX, timeout, sigmask);
+	for (int i = 0; i < count; i++)
+		ready[i] = events[i].data.ptr;
+	return count;
+#else
+	VisEventSourceList *sources = &vis->loop.sources;
+	fd_set rfds, wfds;
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	int maxfd = -1;
+	for (VisDACount i = 0; i < sources->count; i++) {
+		VisEventSource *source = sources->data + i;
+		if (source->flags & VisEventSourceFlag_Read)
+			FD_SET(source->fd, &rfds);
+		if (source->flags & VisEventSourceFlag_Write)
+			FD_SET(source->fd, &wfds);
+		maxfd = MAX(maxfd, source->fd);
+	}
+	struct timespec wait = {.tv_sec = timeout / 1000, .tv_nsec = (timeout % 1000) * 1000000};
+	int r = pselect(maxfd + 1, &rfds, &wfds, NULL, timeout < 0 ? NULL : &wait, sigmask);
+	int count = 0;
+	for (VisDACount i = 0; r > 0 && i < sources->count && count < VIS_EVENT_READY_MAX; i++) {
+		int fd = sources->data[i].fd;
+		if (FD_ISSET(fd, &rfds) || FD_ISSET(fd, &wfds))
+			ready[count++] = sources->data[i].data;
+	}
+	return r < 0 ? r : count;
+#endif
+}
+
+static void timer_heap_up(VisTimerList *timers, VisDACount i) {
+	VisTimer timer = timers->data[i];
+	while (i > 0) {
+		VisDACount parent = (i - 1) / 2;
+		if (timers->data[parent].deadline <= timer.deadline)
+			break;
+		timers->data[i] = timers->data[parent];
+		i = parent;
+	}
+	timers->data[i] = timer;
+}
+
+static void timer_heap_down(VisTimerList *timers, VisDACount i) {
+	VisTimer timer = timers->data[i];
+	for (;;) {
+		VisDACount child = 2 * i + 1;
+		if (child >= timers->count)
+			break;
+		if (child + 1 < timers->count && timers->data[child + 1].deadline < timers->data[child].deadline)
+			child++;
+		if (timer.deadline <= timers->data[child].deadline)
+			break;
+		timers->data[i] = timers->data[child];
+		i = child;
+	}
+	timers->data[i] = timer;
+}
+
+static void timer_heap_remove(VisTimerList *timers, VisDACount i) {
+	timers->data[i] = timers->data[--timers->count];
+	if (i < timers->count) {
+		timer_heap_down(timers, i);
+		timer_heap_up(timers, i);
+	}
+}
+
+/* call func after timeout and then every interval milliseconds unless interval
+ * is zero, returns an id to cancel the timer */
+VIS_INTERNAL u32
+vis_timer_add(Vis *vis, u32 timeout, u32 interval, VisTimerFunction *func, void *context)
+{
+	VisEventLoop *loop = &vis->loop;
+	/* 0 is never a valid id */
+	if (!++loop->timer_id)
+		loop->timer_id++;
+	*da_push(vis, &loop->timers) = (VisTimer){
+		.deadline = vis_time_ms() + timeout,
+		.interval = interval,
+		.id = loop->timer_id,
+		.func = func,
+		.context = context,
+	};
+	timer_heap_up(&loop->timers, loop->timers.count - 1);
+	return loop->timer_id;
+}
+
+VIS_INTERNAL bool
+vis_timer_cancel(Vis *vis, u32 id)
+{
+	VisTimerList *timers = &vis->loop.timers;
+	for (VisDACount i = 0; i < timers->count; i++) {
+		if (timers->data[i].id == id) {
+			timer_heap_remove(timers, i);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* milliseconds until the next timer or the mode idle function is due, -1 if none is pending */
+VIS_INTERNAL int
+vis_event_loop_timeout(Vis *vis)
+{
+	VisEventLoop *loop = &vis->loop;
+	u64 deadline = loop->timers.count ? loop->timers.data[0].deadline : U64_MAX;
+	if (loop->idle && loop->idle < deadline)
+		deadline = loop->idle;
+	if (deadline == U64_MAX)
+		return -1;
+	u64 now = vis_time_ms();
+	return deadline <= now ? 0 : MIN(deadline - now, (u64)S32_MAX);
+}
+
+/* run all expired timers and the mode idle function if it is due */
+VIS_INTERNAL void
+vis_event_loop_expire(Vis *vis)
+{
+	VisEventLoop *loop = &vis->loop;
+	VisTimerList *timers = &loop->timers;
+	u64 now = vis_time_ms();
+	/* timers added by the callbacks wait for the next iteration */
+	for (VisDACount pending = timers->count; pending > 0 && timers->count; pending--) {
+		VisTimer timer = timers->data[0];
+		if (timer.deadline > now)
+			break;
+		if (timer.interval) {
+			/* skip missed periods instead of trying to catch up */
+			timers->data[0].deadline += timer.interval;
+			if (timers->data[0].deadline <= now)
+				timers->data[0].deadline = now + timer.interval;
+			timer_heap_down(timers, 0);
+		} else {
+			timer_heap_remove(timers, 0);
+		}
+		timer.func(vis, &timer);
+	}
+
+	if (loop->idle && loop->idle <= now) {
+		loop->idle = 0;
+		if (vis->mode->idle)
+			vis->mode->idle(vis);
+	}
+}
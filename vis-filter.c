@@ -0,0 +1,292 @@
+/* Filter commands running in the background.
+ *
+ * `|` hands the selected range to an external command and replaces it by the
+ * command's output. Instead of waiting for the command to terminate, the
+ * main loop feeds its stdin directly from the pieces of the text whenever
+ * the pipe becomes writable and collects stdout and stderr as they become
+ * readable. Meanwhile the editor stays usable, a progress indicator is shown
+ * for commands taking a while and <C-c> cancels them.
+ *
+ * The output is read directly into the blocks of the text, such that once
+ * the command terminated successfully the range is replaced by pieces
+ * referring to it in a single revision, without copying it again. If the
+ * file was modified in the meantime the range no longer refers to the text
+ * which was filtered, hence the output is dropped.
+ */
+
+#ifndef FILTER_PROGRESS_DELAY
+#define FILTER_PROGRESS_DELAY 250 /* ms before the progress indicator is shown */
+#endif
+
+/* fewer but larger transfers when feeding big ranges, failure is harmless */
+static void pipe_enlarge(int fd) {
+#if defined(__linux__)
+	fcntl(fd, F_SETPIPE_SZ, 1 << 20);
+#endif
+}
+
+static void filter_close(Vis *vis, int *fd) {
+	if (*fd == -1)
+		return;
+	vis_event_source_remove(vis, *fd);
+	close(*fd);
+	*fd = -1;
+}
+
+static void filter_free(Vis *vis, VisFilter *filter) {
+	filter_close(vis, &filter->inpfd);
+	filter_close(vis, &filter->outfd);
+	filter_close(vis, &filter->errfd);
+	if (filter->progress)
+		vis_timer_cancel(vis, filter->progress);
+	if (filter->file)
+		text_input_discard(filter->file->text, &filter->out);
+	buffer_release(&filter->err);
+	*filter = (VisFilter){.inpfd = -1, .outfd = -1, .errfd = -1};
+}
+
+static void filter_progress(Vis *vis, const VisTimer *timer) {
+	VisFilter *filter = &vis->filter;
+	size_t size = text_range_size(filter->range);
+	filter->reported = true;
+	vis_info_show(vis, "Filtering: %zu%% written, %lld KiB read (<C-c> to cancel)",
+	              size ? filter->written * 100 / size : 100,
+	              (long long)filter->out.len / 1024);
+}
+
+/* write as much of the range as the pipe accepts */
+static void filter_write(Vis *vis, VisFilter *filter) {
+	Text *txt = filter->file->text;
+	size_t size = text_range_size(filter->range);
+	while (filter->inpfd != -1 && filter->written < size) {
+		Filerange rest = text_range_new(filter->range.start + filter->written, filter->range.end);
+		ssize_t written = text_pipe_range(txt, rest, filter->inpfd);
+		if (written > 0)
+			filter->written += written;
+		else if (written == -1 && errno == EAGAIN)
+			return;
+		else if (written == 0 || errno != EINTR)
+			break;
+	}
+	/* either everything was written or the command stopped reading */
+	filter_close(vis, &filter->inpfd);
+}
+
+static void filter_read_output(Vis *vis, VisFilter *filter) {
+	while (filter->outfd != -1) {
+		ssize_t len = text_input_read(vis, filter->file->text, &filter->out, filter->outfd);
+		if (len == -1 && errno == ENOMEM)
+			vis_oom(vis);
+		else if (len == -1 && errno == EAGAIN)
+			return;
+		else if (len == 0 || (len == -1 && errno != EINTR))
+			break;
+	}
+	filter_close(vis, &filter->outfd);
+}
+
+static void filter_read(Vis *vis, int *fd, Buffer *buf) {
+	while (*fd != -1) {
+		if (!buffer_grow(buf, BUFSIZ))
+			vis_oom(vis);
+		ssize_t len = read(*fd, buf->data + buf->length, buf->size - buf->length);
+		if (len > 0)
+			buf->length += len;
+		else if (len == -1 && errno == EAGAIN)
+			return;
+		else if (len == 0 || errno != EINTR)
+			break;
+	}
+	filter_close(vis, fd);
+}
+
+static void filter_apply(Vis *vis, VisFilter *filter) {
+	File *file = filter->file;
+	Filerange range = filter->range;
+	size_t len = filter->out.len, lines = 0;
+	for (VisDACount i = 0; i < filter->out.count; i++)
+		lines += filter->out.data[i].lines;
+
+	/* as with sam commands, selections within the range end up at the output */
+	SelectionList moved = {0};
+	for (Win *win = vis->windows; win; win = win->next) {
+		if (win->file != file)
+			continue;
+		for (Selection *s = view_selections(&win->view); s; s = view_selections_next(s)) {
+			size_t pos = view_cursors_pos(s);
+			if (range.start <= pos && pos <= range.end)
+				*da_push(vis, &moved) = s;
+		}
+	}
+
+	vis_file_snapshot(vis, file);
+	TextEdit edit = {.range = range, .input = &filter->out};
+	if (text_edit_batch(vis, file->text, &edit, 1))
+		text_input_release(&filter->out);
+	else
+		vis_info_show(vis, "Failed to apply filter output");
+	vis_file_snapshot(vis, file);
+
+	size_t pos = range.start;
+	if (lines == 0)
+		pos += len;
+	for (VisDACount i = 0; i < moved.count; i++)
+		view_cursors_to(moved.data[i], pos);
+	da_release(&moved);
+
+	for (Win *win = vis->windows; win; win = win->next) {
+		if (win->file == file)
+			view_selections_normalize(&win->view);
+	}
+}
+
+static void filter_finish(Vis *vis, int status) {
+	VisFilter *filter = &vis->filter;
+	if (filter->reported)
+		vis_ui_info_hide(&vis->ui);
+	if (text_version(filter->file->text) != filter->version) {
+		vis_info_show(vis, "Filter output discarded, file was modified");
+	} else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+		filter_apply(vis, filter);
+	} else {
+		vis_buffer_terminate(&filter->err);
+		vis_info_show(vis, "Command failed %s", buffer_content0(&filter->err));
+	}
+	filter_free(vis, filter);
+}
+
+/* Starts cmd with range of file as its input, the output replaces the range
+ * once the command terminated. Only one filter runs at a time. */
+VIS_INTERNAL bool
+vis_filter_start(Vis *vis, File *file, Filerange range, const char *argv[])
+{
+	VisFilter *filter = &vis->filter;
+	if (filter->file) {
+		vis_info_show(vis, "Another filter is still running");
+		return false;
+	}
+
+	int pin[2], pout[2], perr[2];
+	if (pipe(pin) == -1)
+		goto err;
+	if (pipe(pout) == -1)
+		goto err_in;
+	if (pipe(perr) == -1)
+		goto err_out;
+
+	int *pipes[] = {pin, pout, perr};
+	for (size_t i = 0; i < LENGTH(pipes); i++) {
+		fcntl(pipes[i][0], F_SETFD, FD_CLOEXEC);
+		fcntl(pipes[i][1], F_SETFD, FD_CLOEXEC);
+	}
+	/* see _vis_pipe, programs may behave differently when
+	 * reading from an immediately closed pipe */
+	int null = -1;
+	if (text_range_size(range) == 0 && (null = open("/dev/null", O_RDONLY|O_CLOEXEC)) == -1)
+		goto err_all;
+	pid_t pid = vis_spawn(vis, file, argv, (int[]){null != -1 ? null : pin[0], pout[1], perr[1]});
+	if (null != -1)
+		close(null);
+	if (pid == -1)
+		goto err_all;
+
+	close(pin[0]);
+	close(pout[1]);
+	close(perr[1]);
+	*filter = (VisFilter){
+		.file = file,
+		.range = range,
+		.version = text_version(file->text),
+		.pid = pid,
+		.inpfd = pin[1],
+		.outfd = pout[0],
+		.errfd = perr[0],
+	};
+	if (text_range_size(range) == 0) {
+		close(filter->inpfd);
+		filter->inpfd = -1;
+	} else {
+		pipe_enlarge(filter->inpfd);
+	}
+
+	int *fds[] = {&filter->inpfd, &filter->outfd, &filter->errfd};
+	for (size_t i = 0; i < LENGTH(fds); i++) {
+		int fd = *fds[i];
+		if (fd == -1)
+			continue;
+		VisEventSourceFlags flags = VisEventSourceFlag_Edge;
+		flags |= fd == filter->inpfd ? VisEventSourceFlag_Write : VisEventSourceFlag_Read;
+		if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1 ||
+		    !vis_event_source_add(vis, fd, filter, flags)) {
+			/* not yet registered sources are closed just the same */
+			vis_info_show(vis, "Cannot watch filter: %s", strerror(errno));
+			vis_filter_cancel(vis);
+			return false;
+		}
+	}
+
+	filter->progress = vis_timer_add(vis, FILTER_PROGRESS_DELAY, FILTER_PROGRESS_DELAY,
+	                                 filter_progress, NULL);
+	return true;
+
+err_all:
+	close(perr[0]);
+	close(perr[1]);
+err_out:
+	close(pout[0]);
+	close(pout[1]);
+err_in:
+	close(pin[0]);
+	close(pin[1]);
+err:
+	vis_info_show(vis, "Cannot start filter: %s", strerror(errno));
+	return false;
+}
+
+/* Kills a running filter and discards its output, returns whether one was running. */
+VIS_INTERNAL bool
+vis_filter_cancel(Vis *vis)
+{
+	VisFilter *filter = &vis->filter;
+	if (!filter->file)
+		return false;
+	if (filter->reported)
+		vis_ui_info_hide(&vis->ui);
+	kill(filter->pid, SIGTERM);
+	while (waitpid(filter->pid, NULL, 0) == -1 && errno == EINTR);
+	filter_free(vis, filter);
+	return true;
+}
+
+/* Exchanges data with the filter, to be called once one of its pipes became ready. */
+VIS_INTERNAL void
+vis_filter_io(Vis *vis)
+{
+	VisFilter *filter = &vis->filter;
+	if (!filter->file)
+		return;
+	if (filter->inpfd != -1 && text_version(filter->file->text) != filter->version) {
+		vis_filter_cancel(vis);
+		vis_info_show(vis, "Filter cancelled, file was modified");
+		return;
+	}
+	filter_write(vis, filter);
+	filter_read_output(vis, filter);
+	filter_read(vis, &filter->errfd, &filter->err);
+	vis_filter_tick(vis);
+}
+
+/* Applies the output once the filter closed its pipes and terminated. */
+VIS_INTERNAL void
+vis_filter_tick(Vis *vis)
+{
+	VisFilter *filter = &vis->filter;
+	if (!filter->file || filter->outfd != -1 || filter->errfd != -1)
+		return;
+	int status;
+	pid_t pid = waitpid(filter->pid, &status, WNOHANG);
+	if (pid == filter->pid)
+		filter_finish(vis, status);
+	else if (pid == -1 && errno != EINTR)
+		filter_finish(vis, -1);
+}
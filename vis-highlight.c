@@ -0,0 +1,321 @@
+/* Incremental syntax highlighting.
+ *
+ * The tokens produced by a lexer are cached per window together with a copy
+ * of the text they were produced from. A token which starts at the beginning
+ * of a line acts as a checkpoint: lexing can be resumed from there with the
+ * same outcome as if it had never been interrupted.
+ *
+ * Upon modification, the old and new content of the cached range are compared
+ * to find the modified region. Tokens before the last checkpoint preceding it
+ * are kept, those after it are set aside. Lexing then resumes in chunks from
+ * the checkpoint until one of its checkpoints past the modified region
+ * coincides with one of the set aside tokens. From there on the lexer would
+ * produce the very same tokens again, hence they are reused:
+ *
+ *   before  |tok|tok|tok|tok|tok|tok|tok|tok|tok|
+ *                   ^    ~~~                     modified
+ *   after   |tok|tok|tok|to|t|tok|tok|tok|tok|tok|
+ *                   ^         ^
+ *                   |         converged, remaining tokens are reused
+ *                   resumed lexing
+ *
+ * Lexers are assumed to be line based in the sense that they depend neither
+ * on text before a line they start at nor on text far beyond the current one.
+ */
+
+#ifndef HIGHLIGHT_CHUNK_SIZE
+#define HIGHLIGHT_CHUNK_SIZE (1 << 14)
+#endif
+
+VIS_INTERNAL void
+vis_highlight_reset(Win *win)
+{
+	Highlight *hl = &win->highlight;
+	hl->tokens.count = 0;
+	hl->tail.count = 0;
+	hl->start = hl->end = 0;
+	hl->txt = NULL;
+	hl->lexer = NULL;
+}
+
+VIS_INTERNAL void
+vis_highlight_free(Win *win)
+{
+	Highlight *hl = &win->highlight;
+	da_release(&hl->tokens);
+	da_release(&hl->tail);
+	free(hl->text);
+	free(hl->data);
+}
+
+/* read [start, end) into one of the two buffers */
+static char *highlight_read(Highlight *hl, Text *txt, size_t start, size_t end, bool copy) {
+	char **buf = copy ? &hl->text : &hl->data;
+	size_t *size = copy ? &hl->text_size : &hl->data_size;
+	size_t len = end - start;
+	if (len > *size) {
+		char *data = realloc(*buf, len);
+		if (!data)
+			return NULL;
+		*buf = data;
+		*size = len;
+	}
+	text_bytes_get(txt, start, len, *buf);
+	return *buf;
+}
+
+/* index of the first token with tokens[i].start >= pos */
+static VisDACount highlight_token_find(HighlightTokenList *tokens, size_t pos) {
+	VisDACount lo = 0, hi = tokens->count;
+	while (lo < hi) {
+		VisDACount mid = lo + (hi - lo) / 2;
+		if (tokens->data[mid].start < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Map the cached tokens onto the modified text, returns false if the
+ * modifications can not be located and everything needs to be redone. */
+static bool highlight_damage(Vis *vis, Highlight *hl, Text *txt) {
+	size_t start = hl->start == 0 ? 0 : text_mark_get(txt, hl->start_mark);
+	size_t end = text_mark_get(txt, hl->end_mark);
+	char c;
+	if (start == EPOS || end == EPOS || end < start ||
+	    (start > 0 && (!text_byte_get(txt, start - 1, &c) || c != '\n')))
+		return false;
+
+	size_t old_len = hl->end - hl->start, new_len = end - start;
+	const char *old = hl->text, *new = highlight_read(hl, txt, start, end, false);
+	if (new_len && !new)
+		return false;
+	size_t prefix = 0, suffix = 0, max = MIN(old_len, new_len);
+	while (prefix < max && old[prefix] == new[prefix])
+		prefix++;
+	while (suffix < max - prefix && old[old_len-1-suffix] == new[new_len-1-suffix])
+		suffix++;
+
+	HighlightTokenList *tokens = &hl->tokens;
+	hl->tail.count = 0;
+	if (prefix == old_len && prefix == new_len) {
+		/* merely moved by modifications elsewhere */
+		for (VisDACount i = 0; i < tokens->count; i++) {
+			tokens->data[i].start = tokens->data[i].start - hl->start + start;
+			tokens->data[i].end = tokens->data[i].end - hl->start + start;
+		}
+		hl->start = start;
+		hl->end = end;
+		return true;
+	}
+
+	/* set aside tokens starting after the last modified byte */
+	size_t unchanged = hl->end - suffix;
+	for (VisDACount i = highlight_token_find(tokens, unchanged + 1); i < tokens->count; i++) {
+		HighlightToken *t = da_push(vis, &hl->tail);
+		*t = tokens->data[i];
+		t->start = t->start - hl->end + end;
+		t->end = t->end - hl->end + end;
+	}
+
+	/* resume at the last checkpoint before the first modified byte */
+	VisDACount keep = highlight_token_find(tokens, hl->start + prefix);
+	while (keep > 0 && !tokens->data[keep-1].line_start)
+		keep--;
+	keep = keep > 0 ? keep - 1 : 0;
+	size_t resume = keep < tokens->count ? tokens->data[keep].start : hl->start;
+	for (VisDACount i = 0; i < keep; i++) {
+		tokens->data[i].start = tokens->data[i].start - hl->start + start;
+		tokens->data[i].end = tokens->data[i].end - hl->start + start;
+	}
+	tokens->count = keep;
+	hl->end = resume - hl->start + start;
+	hl->start = start;
+	hl->damage = end - suffix;
+	return true;
+}
+
+/* drop cached tokens far away from the viewport, the remaining ones start at a checkpoint */
+static void highlight_trim(Highlight *hl, size_t start, size_t end) {
+	HighlightTokenList *tokens = &hl->tokens;
+	if (hl->start < start) {
+		VisDACount first = highlight_token_find(tokens, start);
+		while (first > 0 && !(first < tokens->count && tokens->data[first].line_start))
+			first--;
+		if (first > 0) {
+			memmove(tokens->data, tokens->data + first, (tokens->count - first) * sizeof(*tokens->data));
+			tokens->count -= first;
+			hl->start = tokens->data[0].start;
+		}
+	}
+	if (end < hl->end) {
+		VisDACount last = highlight_token_find(tokens, end);
+		while (last < tokens->count && !tokens->data[last].line_start)
+			last++;
+		if (last < tokens->count) {
+			hl->end = tokens->data[last].start;
+			tokens->count = last;
+		}
+	}
+}
+
+/* try to continue with the set aside tokens at a checkpoint of the newly lexed ones */
+static void highlight_converge(Vis *vis, Highlight *hl, VisDACount first) {
+	HighlightTokenList *tokens = &hl->tokens, *tail = &hl->tail;
+	VisDACount t = 0;
+	for (VisDACount i = first; i <= tokens->count && t < tail->count; i++) {
+		size_t pos = i < tokens->count ? tokens->data[i].start : hl->end;
+		if (i < tokens->count && !tokens->data[i].line_start)
+			continue;
+		if (pos <= hl->damage)
+			continue;
+		while (t < tail->count && tail->data[t].start < pos)
+			t++;
+		if (t < tail->count && tail->data[t].start == pos && tail->data[t].line_start) {
+			tokens->count = i;
+			for (; t < tail->count; t++)
+				*da_push(vis, tokens) = tail->data[t];
+			hl->end = tokens->data[tokens->count-1].end;
+			tail->count = 0;
+			return;
+		}
+	}
+	/* set aside tokens before the current end are of no further use */
+	VisDACount used = highlight_token_find(tail, hl->end);
+	memmove(tail->data, tail->data + used, (tail->count - used) * sizeof(*tail->data));
+	tail->count -= used;
+}
+
+/* lex [hl->end, to) and append the resulting tokens, only those preceding the last
+ * checkpoint are kept unless complete is set. returns whether progress was made or
+ * -1 if the lexer failed */
+static int highlight_lex(Vis *vis, Highlight *hl, Text *txt, size_t to, bool complete,
+                          HighlightLex *lex, void *context) {
+	HighlightTokenList *tokens = &hl->tokens;
+	size_t from = hl->end;
+	const char *data = highlight_read(hl, txt, from, to, false);
+	VisDACount first = tokens->count;
+	if (!data || !lex(vis, context, data, to - from, tokens)) {
+		tokens->count = first;
+		return -1;
+	}
+	char c = '\n';
+	if (from > 0)
+		text_byte_get(txt, from - 1, &c);
+
+	/* lexers report token ends relative to the data, validate and complete them */
+	VisDACount count = first;
+	for (VisDACount i = first; i < tokens->count; i++) {
+		HighlightToken t = tokens->data[i];
+		size_t start = count > first ? tokens->data[count-1].end : from;
+		if (t.end > to - from || from + t.end <= start)
+			continue;
+		t.start = start;
+		t.end += from;
+		t.line_start = (start > from ? data[start-from-1] : c) == '\n';
+		tokens->data[count++] = t;
+	}
+	tokens->count = count;
+	if (count == first) {
+		return 0;
+	} else if (complete) {
+		hl->end = tokens->data[count-1].end;
+	} else {
+		VisDACount last = count - 1;
+		while (last > first && !tokens->data[last].line_start)
+			last--;
+		if (last == first)
+			return 0;
+		hl->end = tokens->data[last].start;
+		tokens->count = last;
+	}
+	if (hl->tail.count)
+		highlight_converge(vis, hl, first);
+	return 1;
+}
+
+VIS_INTERNAL void
+vis_highlight(Win *win, const void *lexer, size_t horizon, HighlightLex *lex, void *context)
+{
+	Vis *vis = win->vis;
+	View *view = &win->view;
+	Text *txt = win->file->text;
+	Highlight *hl = &win->highlight;
+	size_t size = text_size(txt);
+	size_t start = text_line_begin(txt, view->start - MIN(view->start, horizon));
+	size_t old_start = hl->start, old_end = hl->end;
+
+	if (hl->lexer != lexer || hl->txt != txt) {
+		vis_highlight_reset(win);
+		hl->lexer = lexer;
+		hl->txt = txt;
+		hl->version = text_version(txt);
+		hl->start = hl->end = start;
+		old_end = EPOS;
+	} else if (hl->version != text_version(txt)) {
+		hl->version = text_version(txt);
+		old_end = EPOS;
+		if (!highlight_damage(vis, hl, txt)) {
+			vis_highlight_reset(win);
+			hl->lexer = lexer;
+			hl->txt = txt;
+			hl->start = hl->end = start;
+		}
+	}
+
+	if (start < hl->start) {
+		/* resume lexing further up, what was lexed so far might be reused */
+		if (!hl->tail.count) {
+			for (VisDACount i = 0; i < hl->tokens.count; i++)
+				*da_push(vis, &hl->tail) = hl->tokens.data[i];
+			hl->damage = start;
+		}
+		hl->tokens.count = 0;
+		hl->start = hl->end = start;
+	} else if (hl->end + horizon < view->start) {
+		hl->tokens.count = 0;
+		hl->tail.count = 0;
+		hl->start = hl->end = start;
+	}
+
+	for (size_t chunk = HIGHLIGHT_CHUNK_SIZE; hl->end < size; ) {
+		bool needed = hl->end < view->end;
+		bool converging = hl->tail.count && hl->end < view->end + horizon;
+		if (!needed && !converging)
+			break;
+		size_t to = MIN(size, MAX(view->end, hl->end + chunk));
+		if (to < size)
+			to = text_line_next(txt, to);
+		/* if no checkpoint is found within a reasonable distance, accept whatever was lexed */
+		bool complete = to == size || to > view->end + horizon;
+		int progress = highlight_lex(vis, hl, txt, to, complete, lex, context);
+		if (progress > 0)
+			chunk = HIGHLIGHT_CHUNK_SIZE;
+		else if (progress < 0 || complete)
+			break;
+		else
+			chunk *= 2;
+	}
+	hl->tail.count = 0;
+
+	highlight_trim(hl, start, view->end + 2 * horizon);
+	if (hl->start != old_start || hl->end != old_end) {
+		if (hl->end > hl->start && !highlight_read(hl, txt, hl->start, hl->end, true)) {
+			vis_highlight_reset(win);
+			return;
+		}
+		hl->start_mark = text_mark_set(txt, hl->start);
+		hl->end_mark = text_mark_set(txt, hl->end);
+	}
+
+	HighlightTokenList *tokens = &hl->tokens;
+	VisDACount i = highlight_token_find(tokens, view->start);
+	if (i > 0)
+		i--;
+	for (; i < tokens->count && tokens->data[i].start <= view->end; i++) {
+		HighlightToken *t = tokens->data + i;
+		if (t->style != HIGHLIGHT_UNSTYLED && t->end > view->start)
+			vis_win_style(win, t->start, t->end - 1, t->style);
+	}
+}
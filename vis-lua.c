@@ -439,6 +439,25 @@ static void pushrange(lua_State *L, Filerange r)
 	}
 }
 
+/* push the content of range as a string, straight from the text if it is stored contiguously */
+static void pushtext(lua_State *L, Text *txt, Filerange r)
+{
+	str8 chunk;
+	TextChunks chunks = text_chunks_get(txt, r);
+	if (!text_chunks_next(&chunks, &chunk)) {
+		lua_pushliteral(L, "");
+	} else if ((size_t)chunk.length == text_range_size(r)) {
+		lua_pushlstring(L, (char *)chunk.data, chunk.length);
+	} else {
+		luaL_Buffer buf;
+		luaL_buffinit(L, &buf);
+		do {
+			luaL_addlstring(&buf, (char *)chunk.data, chunk.length);
+		} while (text_chunks_next(&chunks, &chunk));
+		luaL_pushresult(&buf);
+	}
+}
+
 static Filerange getrange(lua_State *L, int index) {
 	Filerange range = text_range_empty();
 	if (lua_istable(L, index)) {
@@ -1472,6 +1491,8 @@ static int close_subprocess(lua_State *L) {
 		file->f = NULL;
 		file->closef = NULL;
 	}
+	/* the process gets killed once the main loop notices */
+	vis_process_invalidated();
 	return luaL_fileresult(L, result == 0, NULL);
 }
 /***
@@ -1508,6 +1529,81 @@ static int communicate_func(lua_State *L) {
 	}
 	return inputfd->stream.f ? 1 : luaL_fileresult(L, 0, name);
 }
+
+static void timer_lua(Vis *vis, const VisTimer *timer) {
+	lua_State *L = vis->lua;
+	lua_getfield(L, LUA_REGISTRYINDEX, "vis.timers");
+	lua_pushinteger(L, timer->id);
+	lua_rawget(L, -2);
+	if (!timer->interval) {
+		/* single shot timers are done */
+		lua_pushinteger(L, timer->id);
+		lua_pushnil(L);
+		lua_rawset(L, -4);
+	}
+	lua_remove(L, -2);
+	if (!lua_isfunction(L, -1)) {
+		lua_pop(L, 1);
+		return;
+	}
+	lua_pushinteger(L, timer->id);
+	pcall(vis, L, 1, 0);
+}
+
+/***
+ * Call a function after some time elapsed.
+ *
+ * The function is invoked from the main loop, while the editor waits
+ * for input. It receives the timer id as argument.
+ *
+ * @function timer
+ * @tparam int timeout the number of milliseconds after which to call the function
+ * @tparam function func the function to call
+ * @tparam[opt] int interval if given, the function is called again every `interval` milliseconds until the timer is cancelled
+ * @treturn int the timer id, can be passed to @{timer_cancel}
+ * @usage
+ * vis:timer(1000, function(id)
+ * 	vis:info("one second elapsed")
+ * end)
+ */
+static int timer_func(lua_State *L) {
+	Vis *vis = obj_ref_check(L, 1, "vis");
+	lua_Integer timeout = luaL_checkinteger(L, 2);
+	luaL_checktype(L, 3, LUA_TFUNCTION);
+	lua_Integer interval = luaL_optinteger(L, 4, 0);
+	luaL_argcheck(L, 0 <= timeout && timeout <= S32_MAX, 2, "invalid timeout");
+	luaL_argcheck(L, 0 <= interval && interval <= S32_MAX, 4, "invalid interval");
+	u32 id = vis_timer_add(vis, timeout, interval, timer_lua, NULL);
+	lua_getfield(L, LUA_REGISTRYINDEX, "vis.timers");
+	lua_pushinteger(L, id);
+	lua_pushvalue(L, 3);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+	lua_pushinteger(L, id);
+	return 1;
+}
+
+/***
+ * Cancel a timer.
+ *
+ * @function timer_cancel
+ * @tparam int id the timer id as returned by @{timer}
+ * @treturn bool whether the timer was still pending
+ */
+static int timer_cancel(lua_State *L) {
+	Vis *vis = obj_ref_check(L, 1, "vis");
+	lua_Integer id = luaL_checkinteger(L, 2);
+	bool pending = 0 < id && id <= U32_MAX && vis_timer_cancel(vis, id);
+	if (pending) {
+		lua_getfield(L, LUA_REGISTRYINDEX, "vis.timers");
+		lua_pushinteger(L, id);
+		lua_pushnil(L);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+	}
+	lua_pushboolean(L, pending);
+	return 1;
+}
 /***
  * Currently active window.
  * @tfield Window win
@@ -1689,6 +1785,8 @@ static const struct luaL_Reg vis_lua[] = {
 	{ "pipe", pipe_func },
 	{ "redraw", redraw },
 	{ "communicate", communicate_func },
+	{ "timer", timer_func },
+	{ "timer_cancel", timer_cancel },
 	{ "__index", vis_index },
 	{ "__newindex", vis_newindex },
 	{ NULL, NULL },
@@ -1702,6 +1800,7 @@ static const struct luaL_Reg vis_lua[] = {
  * @tfield[opt=50] int escdelay
  * @tfield[opt=false] boolean ignorecase {ic}
  * @tfield[opt="auto"] string loadmethod `"auto"`, `"read"`, or `"mmap"`.
+ * @tfield[opt=60] int maxfps
  * @tfield[opt="/bin/sh"] string shell
  * @see window.options
  */
@@ -2148,6 +2247,65 @@ vis_lua_window_style_pos(lua_State *L)
 	return 1;
 }
 
+/* expects the lexer at stack index 2 and `vis.ui.style_ids` at index 3 */
+static bool window_highlight_lex(Vis *vis, void *context, const char *data, size_t len, HighlightTokenList *tokens) {
+	lua_State *L = context;
+	lua_getfield(L, 2, "lex");
+	lua_pushvalue(L, 2);
+	lua_pushlstring(L, data, len);
+	lua_pushinteger(L, 1);
+	if (pcall(vis, L, 3, 1) != 0 || !lua_istable(L, -1)) {
+		lua_pop(L, 1);
+		return false;
+	}
+	for (int i = 1;; i += 2) {
+		lua_rawgeti(L, -1, i);
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			break;
+		}
+		lua_gettable(L, 3);
+		lua_rawgeti(L, -2, i + 1);
+		lua_Integer pos = lua_isnumber(L, -1) ? lua_tointeger(L, -1) : 0;
+		lua_Integer style = lua_isnumber(L, -2) ? lua_tointeger(L, -2) : -1;
+		lua_pop(L, 2);
+		if (pos < 1)
+			break;
+		HighlightToken *t = da_push(vis, tokens);
+		t->end = pos - 1;
+		t->style = 0 <= style && style < vis->ui.style_count ? style : HIGHLIGHT_UNSTYLED;
+	}
+	lua_pop(L, 1);
+	return true;
+}
+
+/***
+ * Highlight the visible window content using a lexer.
+ *
+ * The tokens of the surrounding area are cached. After modifications
+ * only the affected lines are lexed again.
+ * @function highlight
+ * @tparam table lexer the lexer as returned by `vis.lexers.load`
+ * @tparam[opt=32768] int horizon the number of bytes before the viewport to consider
+ * @usage
+ * win:highlight(vis.lexers.load(win.syntax, nil, true))
+ */
+static int window_highlight(lua_State *L) {
+	Win *win = obj_ref_check(L, 1, VIS_LUA_TYPE_WINDOW);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	size_t horizon = luaL_optinteger(L, 3, 32768);
+	lua_settop(L, 2);
+	lua_getglobal(L, "vis");
+	lua_getfield(L, -1, "ui");
+	lua_getfield(L, -1, "style_ids");
+	lua_replace(L, 3);
+	lua_settop(L, 3);
+	if (!lua_istable(L, 3))
+		return 0;
+	vis_highlight(win, lua_topointer(L, 2), horizon, window_highlight_lex, L);
+	return 0;
+}
+
 /***
  * Set window status line.
  *
@@ -2217,6 +2375,7 @@ static const struct luaL_Reg window_funcs[] = {
 	{ "unmap", window_unmap },
 	{ "style", vis_lua_window_style },
 	{ "style_pos", vis_lua_window_style_pos },
+	{ "highlight", window_highlight },
 	{ "status", window_status },
 	{ "draw", window_draw },
 	{ "close", window_close },
@@ -2283,16 +2442,11 @@ static int window_selections_index(lua_State *L) {
 	View *view = obj_ref_check(L, 1, VIS_LUA_TYPE_SELECTIONS);
 	size_t index = luaL_checkinteger(L, 2);
 	size_t count = view->selection_count;
-	if (index == 0 || index > count)
-		goto err;
-	for (Selection *s = view_selections(view); s; s = view_selections_next(s)) {
-		if (!--index) {
-			obj_lightref_new(L, s, VIS_LUA_TYPE_SELECTION);
-			return 1;
-		}
-	}
-err:
-	lua_pushnil(L);
+	Selection *s = index == 0 || index > count ? NULL : view_selections_nth(view, index - 1);
+	if (s)
+		obj_lightref_new(L, s, VIS_LUA_TYPE_SELECTION);
+	else
+		lua_pushnil(L);
 	return 1;
 }
 
@@ -2559,6 +2713,13 @@ static const struct luaL_Reg window_selection_funcs[] = {
  * File permission.
  * @tfield int permission the file permission bits as of the most recent load/save
  */
+/***
+ * Memory used to track the file content and its undo history.
+ *
+ * A table with the fields `pieces`, `changes`, `revisions` holding the
+ * number of objects in use and `bytes` the memory reserved for them.
+ * @tfield table memory the current memory statistics
+ */
 static int file_index(lua_State *L) {
 	File *file = obj_ref_check(L, 1, VIS_LUA_TYPE_FILE);
 
@@ -2597,6 +2758,20 @@ static int file_index(lua_State *L) {
 			return 1;
 		}
 
+		if (strcmp(key, "memory") == 0) {
+			TextMemoryStats stats = text_memory_stats(file->text);
+			lua_createtable(L, 0, 4);
+			lua_pushinteger(L, stats.pieces);
+			lua_setfield(L, -2, "pieces");
+			lua_pushinteger(L, stats.changes);
+			lua_setfield(L, -2, "changes");
+			lua_pushinteger(L, stats.revisions);
+			lua_setfield(L, -2, "revisions");
+			lua_pushinteger(L, stats.bytes);
+			lua_setfield(L, -2, "bytes");
+			return 1;
+		}
+
 		if (strcmp(key, "savemethod") == 0) {
 			switch (file->save_method) {
 			case TEXT_SAVE_AUTO:
@@ -2732,12 +2907,7 @@ static int file_lines_iterator_it(lua_State *L) {
 	if (*start == text_size(file->text))
 		return 0;
 	size_t end = text_line_end(file->text, *start);
-	size_t len = end - *start;
-	char *buf = lua_newuserdata(L, len);
-	if (!buf && len)
-		return 0;
-	len = text_bytes_get(file->text, *start, len, buf);
-	lua_pushlstring(L, buf, len);
+	pushtext(L, file->text, text_range_new(*start, end));
 	*start = text_line_next(file->text, end);
 	return 1;
 }
@@ -2764,17 +2934,10 @@ static int file_lines_iterator_it(lua_State *L) {
 static int file_content(lua_State *L) {
 	File *file = obj_ref_check(L, 1, VIS_LUA_TYPE_FILE);
 	Filerange range = getrange(L, 2);
-	if (!text_range_valid(range))
-		goto err;
-	size_t len = text_range_size(range);
-	char *data = lua_newuserdata(L, len);
-	if (!data)
-		goto err;
-	len = text_bytes_get(file->text, range.start, len, data);
-	lua_pushlstring(L, data, len);
-	return 1;
-err:
-	lua_pushnil(L);
+	if (text_range_valid(range))
+		pushtext(L, file->text, range);
+	else
+		lua_pushnil(L);
 	return 1;
 }
 
@@ -2907,15 +3070,9 @@ static int file_lines_index(lua_State *L) {
 	size_t start = text_pos_by_lineno(txt, line);
 	size_t end = text_line_end(txt, start);
 	if (start != EPOS && end != EPOS) {
-		size_t size = end - start;
-		char *data = lua_newuserdata(L, size);
-		if (!data && size)
-			goto err;
-		size = text_bytes_get(txt, start, size, data);
-		lua_pushlstring(L, data, size);
+		pushtext(L, txt, text_range_new(start, end));
 		return 1;
 	}
-err:
 	lua_pushnil(L);
 	return 1;
 }
@@ -3334,6 +3491,9 @@ static void vis_lua_init(Vis *vis)
 	/* table in registry to store references to Lua functions */
 	lua_newtable(L);
 	lua_setfield(L, LUA_REGISTRYINDEX, "vis.functions");
+	/* table in registry to store the functions of pending timers */
+	lua_newtable(L);
+	lua_setfield(L, LUA_REGISTRYINDEX, "vis.timers");
 	/* metatable used to type check user data */
 	obj_type_new(L, str8(VIS_LUA_TYPE_VIS));
 	luaL_setfuncs(L, vis_lua, 0);
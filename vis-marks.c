@@ -65,12 +65,7 @@ static FilerangeList mark_get(Vis *vis, Win *win, SelectionRegionList *mark)
 {
 	FilerangeList result = {0};
 	if (mark) {
-		da_reserve(vis, &result, mark->count);
-		for (VisDACount i = 0; i < mark->count; i++) {
-			Filerange r = view_regions_restore(&win->view, mark->data[i]);
-			if (text_range_valid(r))
-				*da_push(vis, &result) = r;
-		}
+		result = view_regions_restore(vis, &win->view, mark);
 		vis_mark_normalize(&result);
 	}
 	return result;
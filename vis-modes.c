@@ -99,21 +99,23 @@ enum VisMode vis_mode_from(Vis *vis, const char *name) {
 	return VIS_MODE_INVALID;
 }
 
-static bool mode_unmap(Mode *mode, const char *key) {
+static bool mode_unmap(Vis *vis, Mode *mode, const char *key) {
+	vis->bindings_version++;
 	return mode && mode->bindings && map_delete(mode->bindings, key);
 }
 
 bool vis_mode_unmap(Vis *vis, enum VisMode id, const char *key) {
-	return id < LENGTH(vis_modes) && mode_unmap(&vis_modes[id], key);
+	return id < LENGTH(vis_modes) && mode_unmap(vis, &vis_modes[id], key);
 }
 
 bool vis_window_mode_unmap(Win *win, enum VisMode id, const char *key) {
-	return id < LENGTH(win->modes) && mode_unmap(&win->modes[id], key);
+	return id < LENGTH(win->modes) && mode_unmap(win->vis, &win->modes[id], key);
 }
 
 static bool mode_map(Vis *vis, Mode *mode, bool force, const char *key, const KeyBinding *binding) {
 	if (!mode)
 		return false;
+	vis->bindings_version++;
 	if (binding->alias && key[0] != '<' && strncmp(key, binding->alias, strlen(key)) == 0)
 		return false;
 	if (!mode->bindings && !(mode->bindings = map_new()))
@@ -131,6 +133,139 @@ bool vis_window_mode_map(Win *win, enum VisMode id, bool force, const char *key,
 	return id < LENGTH(win->modes) && mode_map(win->vis, &win->modes[id], force, key, binding);
 }
 
+static u64 key_hash(u32 state, const char *key, size_t len) {
+	u64 hash = 0xcbf29ce484222325ull ^ state;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (u8)key[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static void key_table_slot_insert(KeyTable *table, VisDACount index) {
+	u32 mask = table->slot_count - 1;
+	u32 i = table->transitions.data[index].hash & mask;
+	while (table->slots[i])
+		i = (i + 1) & mask;
+	table->slots[i] = index + 1;
+}
+
+/* target of the transition for key starting at state, 0 if there is none
+ * (the initial state is never the target of a transition) */
+u32 key_table_next(const KeyTable *table, u32 state, const char *key, size_t len) {
+	if (!table->slot_count)
+		return 0;
+	u64 hash = key_hash(state, key, len);
+	u32 mask = table->slot_count - 1;
+	for (u32 i = hash & mask; table->slots[i]; i = (i + 1) & mask) {
+		const KeyTransition *t = table->transitions.data + table->slots[i] - 1;
+		if (t->hash == hash && t->from == state && t->key_length == len &&
+		    memcmp(table->keys.data + t->key, key, len) == 0)
+			return t->to;
+	}
+	return 0;
+}
+
+static u32 key_table_transition_add(Vis *vis, KeyTable *table, u32 state, const char *key, size_t len) {
+	u32 to = key_table_next(table, state, key, len);
+	if (to)
+		return to;
+	if (2 * (table->transitions.count + 1) > table->slot_count) {
+		u32 slot_count = table->slot_count ? 2 * table->slot_count : 64;
+		u32 *slots = calloc(slot_count, sizeof(*slots));
+		if (!slots)
+			vis_oom(vis);
+		free(table->slots);
+		table->slots = slots;
+		table->slot_count = slot_count;
+		for (VisDACount i = 0; i < table->transitions.count; i++)
+			key_table_slot_insert(table, i);
+	}
+	to = table->states.count;
+	*da_push(vis, &table->states) = (KeyState){.binding_level = U16_MAX, .prefix_level = U16_MAX};
+	table->states.data[state].next++;
+	*da_push(vis, &table->transitions) = (KeyTransition){
+		.hash = key_hash(state, key, len),
+		.from = state,
+		.to = to,
+		.key = table->keys.length,
+		.key_length = len,
+	};
+	if (!buffer_append(&table->keys, key, len))
+		vis_oom(vis);
+	key_table_slot_insert(table, table->transitions.count - 1);
+	return to;
+}
+
+typedef struct {
+	Vis *vis;
+	KeyTable *table;
+	u16 level;
+} KeyTableCompilation;
+
+static bool key_table_add(const char *key, void *value, void *data) {
+	KeyTableCompilation *c = data;
+	KeyTable *table = c->table;
+	u32 state = 0;
+	for (const char *next; *key; key = next) {
+		next = vis_keys_next(c->vis, key);
+		if (table->states.data[state].prefix_level > c->level)
+			table->states.data[state].prefix_level = c->level;
+		state = key_table_transition_add(c->vis, table, state, key, next - key);
+	}
+	KeyState *s = table->states.data + state;
+	if (state && !s->binding) {
+		s->binding = value;
+		s->binding_level = c->level;
+	}
+	return true;
+}
+
+/* Merge the bindings in the order they used to be searched: for every mode
+ * up to the root first the window local ones then the global ones. The
+ * search stopped at the first mode with a longer binding, hence bindings
+ * of later modes are unreachable if the keys are also a prefix. */
+static void key_table_compile(Vis *vis, KeyTable *table, Mode *mode, Win *win) {
+	table->states.count = 0;
+	table->transitions.count = 0;
+	table->keys.length = 0;
+	if (table->slots)
+		memset(table->slots, 0, table->slot_count * sizeof(*table->slots));
+	*da_push(vis, &table->states) = (KeyState){.binding_level = U16_MAX, .prefix_level = U16_MAX};
+
+	KeyTableCompilation c = {.vis = vis, .table = table};
+	for (; mode; mode = mode->parent) {
+		for (int global = 0; global < 2; global++, c.level++) {
+			Mode *m = (global || !win) ? mode : &win->modes[mode->id];
+			if (m->bindings)
+				map_iterate(m->bindings, key_table_add, &c);
+		}
+	}
+
+	for (VisDACount i = 0; i < table->states.count; i++) {
+		KeyState *s = table->states.data + i;
+		if (s->prefix_level < s->binding_level)
+			s->binding = NULL;
+	}
+	table->version = vis->bindings_version;
+}
+
+/* compiled bindings applicable to the current mode and window */
+KeyTable *vis_keys_table(Vis *vis) {
+	Mode *mode = vis->mode;
+	KeyTable *table = vis->win ? &vis->win->modes[mode->id].keys : &mode->keys;
+	if (!table->states.count || table->version != vis->bindings_version)
+		key_table_compile(vis, table, mode, vis->win);
+	return table;
+}
+
+void key_table_free(KeyTable *table) {
+	da_release(&table->states);
+	da_release(&table->transitions);
+	free(table->slots);
+	buffer_release(&table->keys);
+}
+
 /** mode switching event handlers */
 
 static void vis_mode_normal_enter(Vis *vis, Mode *old) {
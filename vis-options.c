@@ -12,6 +12,7 @@ typedef struct {
 enum {
 	OPTION_SHELL,
 	OPTION_ESCDELAY,
+	OPTION_MAXFPS,
 	OPTION_AUTOINDENT,
 	OPTION_EXPANDTAB,
 	OPTION_TABWIDTH,
@@ -45,6 +46,11 @@ static const VisOption vis_options_table[] = {
 		VIS_OPTION_TYPE_NUMBER,
 		VIS_HELP("Milliseconds to wait to distinguish <Escape> from terminal escape sequences")
 	},
+	[OPTION_MAXFPS] = {
+		{ "maxfps" },
+		VIS_OPTION_TYPE_NUMBER,
+		VIS_HELP("Maximum number of screen updates per second, 0 for no limit")
+	},
 	[OPTION_AUTOINDENT] = {
 		{ "autoindent", "ai" },
 		VIS_OPTION_TYPE_BOOL,
@@ -251,6 +257,7 @@ vis_option_set(Vis *vis, Win *win, VisOption *option, VisValue value, bool toggl
 	case OPTION_ESCDELAY:{         vis->escape_delay = MAX(0, value.u.integer);                         }break;
 	case OPTION_EXPANDTAB:{        win->expandtab = toggle ? !win->expandtab : value.u.boolean;         }break;
 	case OPTION_IGNORECASE:{       vis->ignorecase = toggle ? !vis->ignorecase : value.u.boolean;       }break;
+	case OPTION_MAXFPS:{           vis->maxfps = MAX(0, value.u.integer);                               }break;
 	case OPTION_NUMBER_WIDTH:{     win->min_sidebar_width = MAX(0, value.u.integer);                    }break;
 	case OPTION_SHELL:{            vis_shell_set(vis, value.u.string);                                  }break;
 	case OPTION_TABWIDTH:{         view_tabwidth_set(&win->view, value.u.integer);                      }break;
@@ -392,6 +399,7 @@ vis_option_get(Vis *vis, Win *win, VisOption *option)
 		case OPTION_EXPANDTAB:{        result.u.boolean = win->expandtab;         }break;
 		case OPTION_IGNORECASE:{       result.u.boolean = vis->ignorecase;        }break;
 		case OPTION_LAYOUT:{           result.u.integer = vis->ui.layout;         }break;
+		case OPTION_MAXFPS:{           result.u.integer = vis->maxfps;            }break;
 		case OPTION_NUMBER_WIDTH:{     result.u.integer = win->min_sidebar_width; }break;
 		case OPTION_SHELL:{            result.u.string  = vis->shell;             }break;
 		case OPTION_TABWIDTH:{         result.u.integer = win->view.tabwidth;     }break;
@@ -10,8 +10,10 @@ bool vis_prompt_cmd(Vis *vis, const char *cmd) {
 		return vis_motion(vis, VIS_MOVE_SEARCH_BACKWARD, cmd+1);
 	case '+':
 	case ':':
+	{
 		register_put0(vis, &vis->registers[VIS_REG_COMMAND], cmd+1);
 		return vis_cmd(vis, cmd+1);
+	}
 	default:
 		return false;
 	}
@@ -21,13 +23,13 @@ static void
 vis_prompt_remove_empty_line(Text *text)
 {
 	Filerange line_range = text_object_line(text, text->size - 1);
-	char *line = text_bytes_alloc0(text, line_range.start, text_range_size(line_range));
-	if (line && (line[0] == '\n' ||
-	    ((line[0] == ':' || line[0] == '/' || line[0] == '?') && (line[1] == '\n' || line[1] == '\0'))))
+	char line[2];
+	size_t len = text_bytes_get(text, line_range.start, MIN(sizeof line, text_range_size(line_range)), line);
+	if (len > 0 && (line[0] == '\n' ||
+	    ((line[0] == ':' || line[0] == '/' || line[0] == '?') && (len == 1 || line[1] == '\n'))))
 	{
 		text_delete_range(text, line_range);
 	}
-	free(line);
 }
 
 static void
@@ -86,7 +88,12 @@ vis_prompt_enter(Vis *vis, const char *keys, const Arg *arg)
 	prompt_restore(prompt);
 	vis->prompt_state = PROMPTSTATE_COMMAND;
 	vis_redraw(vis);
-	if (vis_prompt_cmd(vis, cmd)) {
+	/* commands of macros, mappings or fed keys need to complete before the
+	 * keys queued behind them, only one typed last may do so in the background */
+	vis->prompt_interactive = !vis->replaying && !*keys;
+	bool ok = vis_prompt_cmd(vis, cmd);
+	vis->prompt_interactive = false;
+	if (ok) {
 		vis_prompt_hide(prompt);
 		/* hide cursor in case it was made visible */
 		// TODO(rnp): cleanup: this looks like a hack
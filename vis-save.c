@@ -0,0 +1,117 @@
+/* Saves committed in the background.
+ *
+ * Writing a large file and waiting for fsync(2) to complete, in particular
+ * on a slow disk or a network file system, would freeze the editor. A `:w`
+ * entered at the prompt therefore only creates the temporary file of an
+ * atomic save and records the pieces of the text to write, see
+ * text_save_snapshot. Writing, syncing and renaming the file is left to a
+ * worker thread, which does not access the text otherwise, such that
+ * editing continues meanwhile. Once it completed, the revision which was
+ * current at the time of the `:w` is marked as saved and the post-save
+ * event is emitted.
+ */
+
+/* Updates file after its text was saved to path and emits the post-save
+ * event, takes ownership of path. */
+VIS_INTERNAL void
+vis_file_saved(Vis *vis, File *file, str8 path, bool update_stat)
+{
+	if (file->filepath.length == 0) {
+		file->filepath = path;
+		update_stat = true;
+	}
+	if (update_stat)
+		file->stat = text_stat(file->text);
+
+	vis_event_emit(vis, VIS_EVENT_FILE_SAVE_POST, file, path.data);
+
+	if (file->filepath.data != path.data)
+		free(path.data);
+}
+
+static void *save_thread(void *data)
+{
+	VisSave *save = data;
+	errno = 0;
+	if (!text_save_commit_snapshot(&save->ctx))
+		save->error = errno ? errno : EIO;
+	/* wakes up the main loop, see vis_run */
+	close(save->done);
+	return NULL;
+}
+
+/* Hands a save begun by text_save_begin over to a worker thread which writes
+ * the given ranges of the text as they are now and commits them. On success
+ * the ownership of ctx and path is transferred, otherwise the caller can
+ * continue the save itself. Only one save runs at a time. */
+VIS_INTERNAL bool
+vis_save_start(Vis *vis, File *file, TextSave *ctx, const Filerange *ranges, size_t count,
+               str8 path, bool update_stat)
+{
+	if (vis->save.file)
+		return false;
+
+	int fds[2];
+	if (pipe(fds) == -1)
+		return false;
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	if (!vis_event_source_add(vis, fds[0], &vis->save, VisEventSourceFlag_Read))
+		goto err;
+	if (!text_save_snapshot(ctx, ranges, count))
+		goto err_source;
+
+	VisSave *save = &vis->save;
+	*save = (VisSave){
+		.file = file,
+		.path = path,
+		.update_stat = update_stat,
+		.ctx = *ctx,
+		.fd = fds[0],
+		.done = fds[1],
+	};
+	/* signals are handled by the main loop */
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	int error = pthread_create(&save->thread, NULL, save_thread, save);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (error == 0)
+		return true;
+
+	/* the snapshot is released along with the save continued by the caller */
+	*save = (VisSave){0};
+err_source:
+	vis_event_source_remove(vis, fds[0]);
+err:
+	close(fds[0]);
+	close(fds[1]);
+	return false;
+}
+
+/* Blocks until a save running in the background completed, then reports it. */
+VIS_INTERNAL void
+vis_save_wait(Vis *vis)
+{
+	if (!vis->save.file)
+		return;
+	VisSave save = vis->save;
+	pthread_join(save.thread, NULL);
+	vis->save = (VisSave){0};
+	vis_event_source_remove(vis, save.fd);
+	close(save.fd);
+
+	if (save.error == 0) {
+		text_mark_saved(&save.ctx);
+		vis_file_saved(vis, save.file, save.path, save.update_stat);
+	} else {
+		vis_info_show(vis, "Can't write `%.*s': %s", (int)save.path.length, save.path.data,
+		              strerror(save.error));
+		free(save.path.data);
+	}
+	/* the status bar reflects whether the file is modified */
+	for (Win *win = vis->windows; win; win = win->next) {
+		if (win->file == save.file)
+			win->view.need_update = true;
+	}
+}
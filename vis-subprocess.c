@@ -5,6 +5,8 @@
 
 /* Pool of information about currently running subprocesses */
 static Process *process_pool;
+/* Whether the pool needs to be checked for processes to be reaped or killed */
+static bool process_pool_check;
 
 /**
  * Adds new empty process information structure to the process pool and
@@ -24,14 +26,17 @@ static Process *new_process_in_pool(void) {
 /**
  * Removes the subprocess information from the pool, sets invalidator to NULL
  * and frees resources.
+ * @param vis the editor instance
  * @param target reference to the process to be removed
  * @return the next process in the pool
  */
-static Process *destroy_process(Process *target) {
+static Process *destroy_process(Vis *vis, Process *target) {
 	if (target->outfd != -1) {
+		vis_event_source_remove(vis, target->outfd);
 		close(target->outfd);
 	}
 	if (target->errfd != -1) {
+		vis_event_source_remove(vis, target->errfd);
 		close(target->errfd);
 	}
 	if (target->inpfd != -1) {
@@ -48,6 +53,112 @@ static Process *destroy_process(Process *target) {
 	return next;
 }
 
+extern char **environ;
+
+/**
+ * Copies the environment with `vis_filepath` and `vis_filename` set to
+ * the path and base name of `file`.
+ * @return a NULL terminated array to be released with `free`, with its
+ * last two entries being allocated separately
+ */
+static char **spawn_environment(File *file) {
+	size_t count = 0;
+	while (environ[count])
+		count++;
+	char **env = calloc(count + 3, sizeof *env);
+	if (!env)
+		return NULL;
+	size_t n = 0;
+	for (char **var = environ; *var; var++) {
+		if (strncmp(*var, "vis_filepath=", 13) && strncmp(*var, "vis_filename=", 13))
+			env[n++] = *var;
+	}
+	str8 name;
+	path_split(file->filepath, 0, &name);
+	const char *path = file->filepath.data ? (char *)file->filepath.data : "";
+	size_t path_len = strlen(path), name_len = name.length;
+	env[n] = malloc(sizeof "vis_filepath=" + path_len);
+	env[n+1] = malloc(sizeof "vis_filename=" + name_len);
+	if (!env[n] || !env[n+1]) {
+		free(env[n]);
+		free(env[n+1]);
+		free(env);
+		return NULL;
+	}
+	snprintf(env[n], sizeof "vis_filepath=" + path_len, "vis_filepath=%s", path);
+	snprintf(env[n+1], sizeof "vis_filename=" + name_len, "vis_filename=%.*s",
+	         (int)name_len, name_len ? (char *)name.data : "");
+	return env;
+}
+
+/**
+ * Starts a command without duplicating the address space of the editor,
+ * the cost of a fork(2) grows with the size of the loaded files.
+ * @param vis the editor instance
+ * @param file if not NULL, exported to the command as `vis_filepath` and
+ * `vis_filename` environment variables
+ * @param argv either a single command line interpreted by the shell or
+ * the NULL terminated arguments of a program searched in `PATH`
+ * @param fds descriptors to become the command's stdin, stdout and stderr,
+ * `-1` to inherit the editor's own. They should be close-on-exec.
+ * A save running in the background is completed beforehand.
+ * @return the process id or `-1` with `errno` set
+ */
+VIS_INTERNAL pid_t vis_spawn(Vis *vis, File *file, const char *argv[], const int fds[3]) {
+	pid_t pid = -1;
+	int err = 0;
+	/* the command might read the file being saved in the background */
+	vis_save_wait(vis);
+	char **env = environ;
+	if (file && !(env = spawn_environment(file)))
+		return -1;
+
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	if ((err = posix_spawn_file_actions_init(&actions)))
+		goto err_actions;
+	if ((err = posix_spawnattr_init(&attr)))
+		goto err_attr;
+	for (int i = 0; i < 3; i++) {
+		if (fds[i] != -1 && (err = posix_spawn_file_actions_adddup2(&actions, fds[i], i)))
+			goto err;
+	}
+
+	/* signals handled by the main loop are blocked, don't pass that on */
+	sigset_t mask;
+	sigprocmask(SIG_SETMASK, NULL, &mask);
+	sigdelset(&mask, SIGTERM);
+	sigdelset(&mask, SIGCHLD);
+	if ((err = posix_spawnattr_setsigmask(&attr, &mask)) ||
+	    (err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK)))
+		goto err;
+
+	if (!argv[1]) {
+		char *const shell[] = {vis->shell, "-c", (char *)argv[0], NULL};
+		err = posix_spawnp(&pid, vis->shell, &actions, &attr, shell, env);
+	} else {
+		err = posix_spawnp(&pid, argv[0], &actions, &attr, (char *const *)argv, env);
+	}
+	if (err)
+		pid = -1;
+err:
+	posix_spawnattr_destroy(&attr);
+err_attr:
+	posix_spawn_file_actions_destroy(&actions);
+err_actions:
+	if (env != environ) {
+		size_t n = 0;
+		while (env[n])
+			n++;
+		free(env[n-2]);
+		free(env[n-1]);
+		free(env);
+	}
+	if (err)
+		errno = err;
+	return pid;
+}
+
 /**
  * Starts new subprocess by passing the `command` to the shell and
  * returns the subprocess information structure, containing file descriptors
@@ -67,110 +178,132 @@ static Process *destroy_process(Process *target) {
 Process *vis_process_communicate(Vis *vis, const char *name,
                                  const char *command, Invalidator **invalidator) {
 	int pin[2], pout[2], perr[2];
-	pid_t pid = (pid_t)-1;
 	if (pipe(perr) == -1) {
-		goto closeerr;
+		goto err;
 	}
 	if (pipe(pout) == -1) {
-		goto closeouterr;
+		goto closeerr;
 	}
 	if (pipe(pin) == -1) {
-		goto closeall;
+		goto closeout;
 	}
-	pid = fork();
+	/* other children must not keep the pipes open */
+	int *fds[] = {pin, pout, perr};
+	for (size_t i = 0; i < LENGTH(fds); i++) {
+		fcntl(fds[i][0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[i][1], F_SETFD, FD_CLOEXEC);
+	}
+	const char *argv[] = {command, NULL};
+	pid_t pid = vis_spawn(vis, NULL, argv, (int[]){pin[0], pout[1], perr[1]});
 	if (pid == -1) {
-		vis_info_show(vis, "fork failed: %s", strerror(errno));
-	} else if (pid == 0) { /* child process */
-		sigset_t sigterm_mask;
-		sigemptyset(&sigterm_mask);
-		sigaddset(&sigterm_mask, SIGTERM);
-		if (sigprocmask(SIG_UNBLOCK, &sigterm_mask, NULL) == -1) {
-			fprintf(stderr, "failed to reset signal mask");
-			exit(EXIT_FAILURE);
-		}
-		dup2(pin[0], STDIN_FILENO);
-		dup2(pout[1], STDOUT_FILENO);
-		dup2(perr[1], STDERR_FILENO);
-	} else { /* main process */
-		Process *new = new_process_in_pool();
-		if (!new) {
-			vis_info_show(vis, "Cannot create process: %s", strerror(errno));
-			goto closeall;
-		}
-		new->name = strdup(name);
-		if (!new->name) {
-			vis_info_show(vis, "Cannot copy process name: %s", strerror(errno));
-			/* pop top element (which is `new`) from the pool */
-			process_pool = destroy_process(process_pool);
-			goto closeall;
-		}
-		new->outfd = pout[0];
-		new->errfd = perr[0];
-		new->inpfd = pin[1];
-		new->pid = pid;
-		new->invalidator = invalidator;
-		close(pin[0]);
-		close(pout[1]);
-		close(perr[1]);
-		return new;
+		goto closeall;
+	}
+	close(pin[0]);
+	close(pout[1]);
+	close(perr[1]);
+
+	Process *new = new_process_in_pool();
+	if (!new) {
+		vis_info_show(vis, "Cannot create process: %s", strerror(errno));
+		goto kill;
+	}
+	new->name = strdup(name);
+	new->outfd = pout[0];
+	new->errfd = perr[0];
+	new->inpfd = pin[1];
+	new->pid = pid;
+	new->invalidator = invalidator;
+	if (!new->name) {
+		vis_info_show(vis, "Cannot copy process name: %s", strerror(errno));
+		goto destroy;
 	}
+	/* output is read whenever the main loop reports new data, what is left
+	 * over keeps the descriptor ready for the next iteration */
+	fcntl(new->outfd, F_SETFL, fcntl(new->outfd, F_GETFL) | O_NONBLOCK);
+	fcntl(new->errfd, F_SETFL, fcntl(new->errfd, F_GETFL) | O_NONBLOCK);
+	VisEventSourceFlags flags = VisEventSourceFlag_Read;
+	if (!vis_event_source_add(vis, new->outfd, new, flags) ||
+	    !vis_event_source_add(vis, new->errfd, new, flags)) {
+		vis_info_show(vis, "Cannot watch process: %s", strerror(errno));
+		goto destroy;
+	}
+	return new;
+
+destroy:
+	new->invalidator = NULL;
+	/* pop top element (which is `new`) from the pool, closes the pipes */
+	process_pool = destroy_process(vis, process_pool);
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	return NULL;
+kill:
+	close(pin[1]);
+	close(pout[0]);
+	close(perr[0]);
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	return NULL;
 closeall:
 	close(pin[0]);
 	close(pin[1]);
-closeouterr:
+closeout:
 	close(pout[0]);
 	close(pout[1]);
 closeerr:
 	close(perr[0]);
 	close(perr[1]);
-	if (pid == 0) { /* start command in child process */
-		execlp(vis->shell, vis->shell, "-c", command, (char*)NULL);
-		fprintf(stderr, "exec failed: %s(%d)\n", strerror(errno), errno);
-		exit(1);
-	} else {
-		vis_info_show(vis, "process creation failed: %s", strerror(errno));
-	}
+err:
+	vis_info_show(vis, "process creation failed: %s", strerror(errno));
 	return NULL;
 }
 
 /**
- * Adds file descriptors of currently running subprocesses to the `readfds`
- * to track their readiness and returns maximum file descriptor value
- * to pass it to the `pselect` call
- * @param readfds the structure for `pselect` call to fill
- * @return maximum file descriptor number in the readfds structure
+ * Reads all data available from the given subprocess file descriptor `fd`
+ * and fires the PROCESS_RESPONSE event in Lua with given subprocess `name`,
+ * `rtype` and the read data as arguments. The descriptor is closed once
+ * the process closed its end.
+ * @param vis the editor instance
+ * @param fd the file descriptor to read data from
+ * @param name a name of the subprocess
+ * @param rtype a type of file descriptor where the new data is found
  */
-int vis_process_before_tick(fd_set *readfds) {
-	int maxfd = 0;
-	for (Process **pointer = &process_pool; *pointer; pointer = &((*pointer)->next)) {
-		Process *current = *pointer;
-		if (current->outfd != -1) {
-			FD_SET(current->outfd, readfds);
-			maxfd = maxfd < current->outfd ? current->outfd : maxfd;
-		}
-		if (current->errfd != -1) {
-			FD_SET(current->errfd, readfds);
-			maxfd = maxfd < current->errfd ? current->errfd : maxfd;
+/* reads at most max chunks of output, such that a process writing faster than
+ * it is consumed does not keep the main loop from processing terminal input */
+static void read_and_fire(Vis* vis, int *fd, const char *name, ResponseType rtype, size_t max) {
+	static char buffer[PIPE_BUF];
+	while (*fd != -1 && max > 0) {
+		ssize_t obtained = read(*fd, &buffer, PIPE_BUF-1);
+		if (obtained > 0) {
+			vis_lua_process_response(vis, name, buffer, obtained, rtype);
+			max--;
+		} else if (obtained == 0) {
+			vis_event_source_remove(vis, *fd);
+			close(*fd);
+			*fd = -1;
+		} else if (errno != EINTR) {
+			break;
 		}
 	}
-	return maxfd;
 }
 
 /**
- * Reads data from the given subprocess file descriptor `fd` and fires
- * the PROCESS_RESPONSE event in Lua with given subprocess `name`,
- * `rtype` and the read data as arguments.
+ * Reads the pending output of a subprocess, to be called once the main
+ * loop reports one of its file descriptors as ready. Output exceeding a
+ * few reads is left for the following iterations.
  * @param vis the editor instance
- * @param fd the file descriptor to read data from
- * @param name a name of the subprocess
- * @param rtype a type of file descriptor where the new data is found
+ * @param process the subprocess
  */
-static void read_and_fire(Vis* vis, int fd, const char *name, ResponseType rtype) {
-	static char buffer[PIPE_BUF];
-	size_t obtained = read(fd, &buffer, PIPE_BUF-1);
-	if (obtained > 0) {
-		vis_lua_process_response(vis, name, buffer, obtained, rtype);
-	}
+void vis_process_read(Vis *vis, Process *process) {
+	read_and_fire(vis, &process->outfd, process->name, STDOUT, 16);
+	read_and_fire(vis, &process->errfd, process->name, STDERR, 16);
+}
+
+/**
+ * Requests the pool to be checked on the next tick, because the stream of
+ * a process was closed and the process needs to be killed.
+ */
+void vis_process_invalidated(void) {
+	process_pool_check = true;
 }
 
 /**
@@ -186,6 +319,9 @@ static bool wait_or_kill_process(Vis *vis, Process *current) {
 	if (wpid == -1) {
 		vis_message_show(vis, strerror(errno));
 	} else if (wpid == current->pid) {
+		/* deliver all output written right before exiting */
+		read_and_fire(vis, &current->outfd, current->name, STDOUT, SIZE_MAX);
+		read_and_fire(vis, &current->errfd, current->name, STDERR, SIZE_MAX);
 		goto just_destroy;
 	} else if (!*(current->invalidator)) {
 		goto kill_and_destroy;
@@ -205,29 +341,17 @@ just_destroy:
 }
 
 /**
- * Checks if `readfds` contains file descriptors of subprocesses from
- * the pool. If so, it reads their data and fires corresponding events.
- * Also checks if each subprocess from the pool is dead or needs to be
- * killed then raises an event or kills it if necessary.
+ * Checks if a subprocess from the pool is dead or needs to be killed
+ * then raises an event or kills it if necessary. Only does so when a child
+ * terminated or a process stream was closed since the last tick.
  * @param vis the editor instance
- * @param readfds the structure for `pselect` call with file descriptors
  */
-void vis_process_tick(Vis *vis, fd_set *readfds) {
-	for (Process **pointer = &process_pool; *pointer; ) {
-		Process *current = *pointer;
-		if (current->outfd != -1 && FD_ISSET(current->outfd, readfds)) {
-			read_and_fire(vis, current->outfd, current->name, STDOUT);
-		}
-		if (current->errfd != -1 && FD_ISSET(current->errfd, readfds)) {
-			read_and_fire(vis, current->errfd, current->name, STDERR);
-		}
-		if (!wait_or_kill_process(vis, current)) {
-			pointer = &current->next;
-		} else {
-			/* update our iteration pointer */
-			*pointer = destroy_process(current);
-		}
-	}
+void vis_process_tick(Vis *vis) {
+	if (!vis->sigchld && !process_pool_check)
+		return;
+	vis->sigchld = false;
+	process_pool_check = false;
+	vis_process_waitall(vis);
 }
 
 /**
@@ -241,7 +365,7 @@ void vis_process_waitall(Vis *vis) {
 			pointer = &current->next;
 		} else {
 			/* update our iteration pointer */
-			*pointer = destroy_process(current);
+			*pointer = destroy_process(vis, current);
 		}
 	}
 }
@@ -22,9 +22,11 @@ struct Process {
 
 typedef enum { STDOUT, STDERR, SIGNAL, EXIT } ResponseType;
 
+VIS_INTERNAL pid_t vis_spawn(Vis *, File *, const char *argv[], const int fds[3]);
 VIS_INTERNAL Process *vis_process_communicate(Vis *, const char *command, const char *name,
                                               Invalidator **invalidator);
-VIS_INTERNAL int vis_process_before_tick(fd_set *);
-VIS_INTERNAL void vis_process_tick(Vis *, fd_set *);
+VIS_INTERNAL void vis_process_read(Vis *, Process *);
+VIS_INTERNAL void vis_process_invalidated(void);
+VIS_INTERNAL void vis_process_tick(Vis *);
 VIS_INTERNAL void vis_process_waitall(Vis *);
 #endif
@@ -16,6 +16,7 @@
 #include "text.c"
 #include "ui-terminal.c"
 #include "view.c"
+#include "vis-highlight.c"
 #include "vis-lua.c"
 #include "vis-marks.c"
 #include "vis-modes.c"
@@ -24,6 +25,9 @@
 #include "vis-prompt.c"
 #include "vis-registers.c"
 #include "vis-subprocess.c"
+#include "vis-event-loop.c"
+#include "vis-filter.c"
+#include "vis-save.c"
 #include "vis-text-objects.c"
 
 VIS_INTERNAL str8
@@ -52,6 +56,10 @@ vis_file_free(Vis *vis, File *file)
 	} else if (file) {
 		if (!file->internal)
 			vis_event_emit(vis, VIS_EVENT_FILE_CLOSE, file);
+		if (vis->filter.file == file)
+			vis_filter_cancel(vis);
+		if (vis->save.file == file)
+			vis_save_wait(vis);
 
 		if (file->prev) file->prev->next = file->next;
 		if (file->next) file->next->prev = file->prev;
@@ -152,8 +160,11 @@ static void window_free(Win *win) {
 			other->parent = NULL;
 	}
 	view_free(&win->view);
-	for (size_t i = 0; i < LENGTH(win->modes); i++)
+	vis_highlight_free(win);
+	for (size_t i = 0; i < LENGTH(win->modes); i++) {
 		map_free(win->modes[i].bindings);
+		key_table_free(&win->modes[i].keys);
+	}
 	for (int i = 0; i < VIS_MARK_SET_LRU_COUNT; i++)
 		da_release(win->mark_set_lru_regions + i);
 	da_release(&win->saved_selections);
@@ -378,6 +389,7 @@ vis_window_file_reload(Vis *vis, Win *win)
 			vis_file_free(vis, win->file);
 			win->file = file;
 			view_reload(&win->view, file->text);
+			vis_highlight_reset(win);
 		}
 	}
 	return result;
@@ -391,6 +403,7 @@ vis_window_file_change(Vis *vis, Win *win, const char *filename)
 		vis_file_free(vis, win->file);
 		win->file = file;
 		view_reload(&win->view, file->text);
+		vis_highlight_reset(win);
 	}
 	return file != 0;
 }
@@ -468,6 +481,9 @@ bool vis_window_new_fd(Vis *vis, int fd) {
 }
 
 bool vis_window_closable(Win *win) {
+	/* a save running in the background might be all that is missing */
+	if (win && win->vis->save.file == win->file)
+		vis_save_wait(win->vis);
 	if (!win || !text_modified(win->file->text))
 		return true;
 	return win->file->refcount > 1;
@@ -536,6 +552,7 @@ bool vis_init(Vis *vis)
 
 	vis->exit_status  = -1;
 	vis->escape_delay = 50;
+	vis->maxfps       = 60;
 	if (!ui_init(&vis->ui))
 		return false;
 	vis->change_colors = true;
@@ -555,6 +572,8 @@ bool vis_init(Vis *vis)
 		goto err;
 	if (!(vis->keymap = map_new()))
 		goto err;
+	if (!vis_event_loop_init(vis))
+		goto err;
 	if (!sam_init(vis))
 		goto err;
 	struct passwd *pw;
@@ -581,6 +600,7 @@ void vis_cleanup(Vis *vis)
 	while (vis->windows)
 		vis_window_close(vis->windows);
 	vis_process_waitall(vis);
+	vis_event_loop_free(vis);
 
 	// NOTE: it is possible for a plugin to call a lua function
 	// such as vis:message() in QUIT which requires the existence
@@ -611,8 +631,10 @@ void vis_cleanup(Vis *vis)
 	map_free(vis->actions);
 	map_free(vis->keymap);
 	buffer_release(&vis->input_queue);
-	for (int i = 0; i < VIS_MODE_INVALID; i++)
+	for (int i = 0; i < VIS_MODE_INVALID; i++) {
 		map_free(vis_modes[i].bindings);
+		key_table_free(&vis_modes[i].keys);
+	}
 	da_release(&vis->operators);
 	da_release(&vis->motions);
 	da_release(&vis->textobjects);
@@ -672,6 +694,8 @@ void vis_replace_key(Vis *vis, const char *data, size_t len) {
 }
 
 bool vis_action_register(Vis *vis, const KeyAction *action) {
+	/* <name> pseudo keys in bindings now form a single key */
+	vis->bindings_version++;
 	return map_put(vis->actions, action->name, action);
 }
 
@@ -997,26 +1021,6 @@ bool vis_keys_utf8(Vis *vis, const char *keys, char utf8[4+1])
 	return result;
 }
 
-typedef struct {
-	Vis *vis;
-	size_t len;         // length of the prefix
-	int count;          // how many bindings can complete this prefix
-	bool angle_bracket; // does the prefix end with '<'
-} PrefixCompletion;
-
-static bool isprefix(const char *key, void *value, void *data) {
-	PrefixCompletion *completion = data;
-	if (!completion->angle_bracket) {
-		completion->count++;
-	} else {
-		const char *start = key + completion->len;
-		const char *end = vis_keys_next(completion->vis, start);
-		if (end && start + 1 == end)
-			completion->count++;
-	}
-	return completion->count == 1;
-}
-
 VIS_INTERNAL void
 vis_keys_process(Vis *vis, s64 pos)
 {
@@ -1025,6 +1029,7 @@ vis_keys_process(Vis *vis, s64 pos)
 	char *keys = (char *)buffer_content0(buf) + pos, *start = keys, *cur = keys, *end = keys, *binding_end = keys;;
 	bool prefix = false;
 	KeyBinding *binding = NULL;
+	u32 state = 0;
 
 	while (cur && *cur) {
 
@@ -1035,39 +1040,14 @@ vis_keys_process(Vis *vis, s64 pos)
 			return;
 		}
 
-		char tmp = *end;
-		*end = '\0';
-		prefix = false;
-
-		for (Mode *global_mode = vis->mode; global_mode && !prefix; global_mode = global_mode->parent) {
-			for (int global = 0; global < 2 && !prefix; global++) {
-				Mode *mode = (global || !vis->win) ?
-					     global_mode :
-				             &vis->win->modes[global_mode->id];
-				if (!mode->bindings)
-					continue;
-				/* keep track of longest matching binding */
-				KeyBinding *match = map_get(mode->bindings, start);
-				if (match && end > binding_end) {
-					binding = match;
-					binding_end = end;
-				}
-
-				const Map *pmap = map_prefix(mode->bindings, start);
-				PrefixCompletion completions = {
-					.vis = vis,
-					.len = cur - start,
-					.count = 0,
-					.angle_bracket = !strcmp(cur, "<"),
-				};
-				map_iterate(pmap, isprefix, &completions);
-
-				prefix = (!match && completions.count > 0) ||
-				         ( match && completions.count > 1);
-			}
+		/* keep track of longest matching binding */
+		KeyTable *table = vis_keys_table(vis);
+		state = key_table_next(table, state, cur, end - cur);
+		if (state && table->states.data[state].binding) {
+			binding = (KeyBinding *)table->states.data[state].binding;
+			binding_end = end;
 		}
-
-		*end = tmp;
+		prefix = state && table->states.data[state].next > 0;
 
 		if (prefix) {
 			/* input so far is ambiguous, wait for more */
@@ -1097,6 +1077,7 @@ vis_keys_process(Vis *vis, s64 pos)
 			}
 			binding = NULL;
 			binding_end = start;
+			state = 0;
 		} else { /* no keybinding */
 			KeyAction *action = NULL;
 			if (start[0] == '<' && end[-1] == '>') {
@@ -1122,6 +1103,7 @@ vis_keys_process(Vis *vis, s64 pos)
 				vis->mode->input(vis, start, end - start);
 			}
 			start = cur = end;
+			state = 0;
 		}
 	}
 
@@ -1156,6 +1138,33 @@ macro_replay_internal(Vis *vis, Macro *macro)
 	}
 }
 
+/* Replays and counted repeats run many commands in a row, drawing in between
+ * would be wasted. While batched, ui_draw only arranges the windows and the
+ * primary cursor is followed by jumping the viewport to it instead of
+ * scrolling. Once the outermost batch completes the viewport is centered on
+ * the cursor if it had to move, everything else is drawn by the next frame. */
+VIS_INTERNAL void
+vis_batch_begin(Vis *vis)
+{
+	vis->batch++;
+}
+
+VIS_INTERNAL void
+vis_batch_end(Vis *vis)
+{
+	if (--vis->batch > 0)
+		return;
+	for (Win *win = vis->windows; win; win = win->next) {
+		View *view = &win->view;
+		if (!view->batch_jumped)
+			continue;
+		view->batch_jumped = false;
+		view_cursors_to(view->selection, view_cursors_pos(view->selection));
+		if (view->selection->line)
+			view_redraw_center(view);
+	}
+}
+
 static void macro_replay(Vis *vis, const Macro *macro)
 {
 	const Macro *replaying = vis->replaying;
@@ -1176,10 +1185,46 @@ void vis_keys_feed(Vis *vis, const char *input) {
 	buffer_release(&macro);
 }
 
+/* Insert the content of a bracketed paste at once instead of processing it key by key */
+static void paste(Vis *vis) {
+	Buffer buf = {0};
+	vis_ui_paste_read(&vis->ui, &buf);
+	/* terminals transmit line breaks as carriage returns */
+	size_t len = 0;
+	for (size_t i = 0; i < buf.length; i++) {
+		if (buf.data[i] == '\r') {
+			buf.data[len++] = '\n';
+			if (i + 1 < buf.length && buf.data[i+1] == '\n')
+				i++;
+		} else {
+			buf.data[len++] = buf.data[i];
+		}
+	}
+	if (len > 0) {
+		if (vis->recording)
+			buffer_append(vis->recording, buf.data, len);
+		if (vis->macro_operator)
+			buffer_append(vis->macro_operator, buf.data, len);
+		vis->mode->input(vis, buf.data, len);
+		vis_file_snapshot(vis, vis->win->file);
+	}
+	buffer_release(&buf);
+}
+
 static const char *getkey(Vis *vis) {
 	TermKeyKey key = { 0 };
 	if (!vis_ui_getkey(vis, &key))
 		return 0;
+	TermKey *termkey = &vis->ui.termkey;
+	/* not typed by the user, the info line stays */
+	if (key.type == TERMKEY_TYPE_MODEREPORT) {
+		int initial, mode, value;
+		termkey_interpret_modereport(termkey, &key, &initial, &mode, &value);
+		/* reply to the synchronized output query sent upon initialization */
+		if (initial == '?' && mode == 2026)
+			vis->ui.synchronized_output = value == 1 || value == 2;
+		return getkey(vis);
+	}
 	vis_ui_info_hide(&vis->ui);
 	bool use_keymap = vis->mode->id != VIS_MODE_INSERT &&
 	                  vis->mode->id != VIS_MODE_REPLACE &&
@@ -1194,12 +1239,18 @@ static const char *getkey(Vis *vis) {
 		}
 	}
 
-	TermKey *termkey = &vis->ui.termkey;
 	if (key.type == TERMKEY_TYPE_UNKNOWN_CSI) {
 		long args[18];
 		size_t nargs;
 		unsigned long cmd;
 		if (termkey_interpret_csi(termkey, &key, &args[2], &nargs, &cmd) == TERMKEY_RES_KEY) {
+			/* start of a bracketed paste, only insert mode bypasses key processing */
+			if (cmd == '~' && nargs > 0 && args[2] == 200 && vis->mode == &vis_modes[VIS_MODE_INSERT] &&
+			    vis->win && !vis->win->file->internal && vis->input_queue.length == 0) {
+				paste(vis);
+				return getkey(vis);
+			}
+
 			args[0] = (long)cmd;
 			args[1] = nargs;
 			vis_event_emit(vis, VIS_EVENT_TERM_CSI, args);
@@ -1234,7 +1285,29 @@ bool vis_signal_handler(Vis *vis, int signum, const siginfo_t *siginfo, const vo
 	case SIGHUP:
 		vis->terminate = true;
 		return true;
+	case SIGCHLD:
+		vis->sigchld = true;
+		return true;
+	}
+	return false;
+}
+
+/* Whether the next frame may be drawn, if not the remaining time is stored in wait.
+ * Redraws requested in the meantime are coalesced into the pending frame. */
+static bool frame_due(Vis *vis, struct timespec *wait) {
+	if (vis->maxfps <= 0)
+		return true;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long interval = 1000000000LL / vis->maxfps;
+	long long elapsed = (now.tv_sec - vis->frame_last.tv_sec) * 1000000000LL +
+	                    (now.tv_nsec - vis->frame_last.tv_nsec);
+	if (elapsed >= interval) {
+		vis->frame_last = now;
+		return true;
 	}
+	wait->tv_sec = (interval - elapsed) / 1000000000LL;
+	wait->tv_nsec = (interval - elapsed) % 1000000000LL;
 	return false;
 }
 
@@ -1254,7 +1327,7 @@ int vis_run(Vis *vis) {
 
 	vis_event_emit(vis, VIS_EVENT_START);
 
-	struct timespec idle = { .tv_nsec = 0 }, *timeout = NULL;
+	struct timespec frame = { .tv_nsec = 0 };
 
 	sigset_t emptyset;
 	sigemptyset(&emptyset);
@@ -1264,10 +1337,6 @@ int vis_run(Vis *vis) {
 	sigsetjmp(vis->sigbus_jmpbuf, 1);
 
 	while (vis->running) {
-		fd_set fds;
-		FD_ZERO(&fds);
-		FD_SET(STDIN_FILENO, &fds);
-
 		if (vis->sigbus) {
 			char *name = NULL;
 			for (Win *next, *win = vis->windows; win; win = next) {
@@ -1283,6 +1352,7 @@ int vis_run(Vis *vis) {
 			else
 				vis_info_show(vis, "WARNING: file `%s' truncated!\n", name ? name : "-");
 			vis->sigbus = false;
+			vis->batch = 0;
 			free(name);
 		}
 
@@ -1290,12 +1360,16 @@ int vis_run(Vis *vis) {
 			vis_die(vis, "Killed by SIGTERM\n");
 		if (vis->interrupted) {
 			vis->interrupted = false;
-			vis_keys_push(vis, str8("<C-c>"), 0, true);
+			if (vis_filter_cancel(vis))
+				vis_info_show(vis, "Command cancelled");
+			else
+				vis_keys_push(vis, str8("<C-c>"), 0, true);
 			continue;
 		}
 
 		if (vis->resume) {
 			ui_terminal_resume(&vis->ui);
+			vis_ui_bracketed_paste(true);
 			vis->resume = false;
 		}
 
@@ -1304,10 +1378,20 @@ int vis_run(Vis *vis) {
 			vis->need_resize = false;
 		}
 
-		ui_draw(vis);
-		idle.tv_sec = vis->mode->idle_timeout;
-		int r = pselect(vis_process_before_tick(&fds) + 1, &fds, NULL, NULL,
-		                timeout, &emptyset);
+		vis_process_tick(vis);
+		vis_filter_tick(vis);
+
+		/* keep processing input while the next frame is pending */
+		int timeout = vis_event_loop_timeout(vis);
+		if (frame_due(vis, &frame)) {
+			ui_draw(vis);
+		} else {
+			int wait = frame.tv_sec * 1000 + (frame.tv_nsec + 999999) / 1000000;
+			if (timeout < 0 || wait < timeout)
+				timeout = wait;
+		}
+		void *ready[VIS_EVENT_READY_MAX];
+		int r = vis_event_loop_wait(vis, ready, timeout, &emptyset);
 		if (r == -1 && errno == EINTR)
 			continue;
 
@@ -1315,23 +1399,35 @@ int vis_run(Vis *vis) {
 			/* TODO save all pending changes to a ~suffixed file */
 			vis_die(vis, "Error in mainloop: %s\n", strerror(errno));
 		}
-		vis_process_tick(vis, &fds);
 
-		if (!FD_ISSET(STDIN_FILENO, &fds)) {
-			if (vis->mode->idle)
-				vis->mode->idle(vis);
-			timeout = NULL;
-			continue;
+		bool input = false;
+		for (int i = 0; i < r; i++) {
+			if (ready[i] == &vis->ui)
+				input = true;
+			else if (ready[i] == &vis->filter)
+				vis_filter_io(vis);
+			else if (ready[i] == &vis->save)
+				vis_save_wait(vis);
+			else
+				vis_process_read(vis, ready[i]);
 		}
+		vis_event_loop_expire(vis);
+		if (!input)
+			continue;
 
 		termkey_advisereadable(&vis->ui.termkey);
 		const char *key;
 
-		while ((key = getkey(vis)))
+		while ((key = getkey(vis))) {
+			/* <C-c> cancels a filter running in the background */
+			if (strcmp(key, "<C-c>") == 0 && vis_filter_cancel(vis)) {
+				vis_info_show(vis, "Command cancelled");
+				continue;
+			}
 			vis_keys_push(vis, str8_from_c_str(key), 0, true);
+		}
 
-		if (vis->mode->idle)
-			timeout = &idle;
+		vis->loop.idle = vis->mode->idle ? vis_time_ms() + 1000 * vis->mode->idle_timeout : 0;
 	}
 	return vis->exit_status;
 }
@@ -1402,8 +1498,10 @@ bool vis_macro_replay(Vis *vis, enum VisRegister id) {
 		return false;
 	int count = VIS_COUNT_DEFAULT(vis->action.count, 1);
 	vis_cancel(vis);
-	for (int i = 0; i < count; i++)
+	vis_batch_begin(vis);
+	for (int i = 0; i < count && !vis->interrupted; i++)
 		macro_replay(vis, macro);
+	vis_batch_end(vis);
 	Win *win = vis->win;
 	if (win)
 		vis_file_snapshot(vis, win->file);
@@ -1427,12 +1525,14 @@ void vis_repeat(Vis *vis) {
 			count = 1;
 		if (vis->action_prev.op == &vis_operators[VIS_OP_MODESWITCH])
 			vis->action_prev.count = 1;
+		vis_batch_begin(vis);
 		for (int i = 0; i < count; i++) {
 			if (vis->interrupted)
 				break;
 			mode_set(vis, mode);
 			macro_replay(vis, macro);
 		}
+		vis_batch_end(vis);
 		vis->action_prev = action_prev;
 	}
 	vis_cancel(vis);
@@ -1591,86 +1691,52 @@ static int _vis_pipe(Vis *vis, File *file, Filerange range, const char* buf, con
 		return -1;
 	}
 
-	ui_terminal_save(&vis->ui, fullscreen);
-	pid_t pid = fork();
-
-	if (pid == -1) {
-		close(pin[0]);
-		close(pin[1]);
-		close(pout[0]);
-		close(pout[1]);
-		close(perr[0]);
-		close(perr[1]);
-		vis_info_show(vis, "fork failure: %s", strerror(errno));
-		return -1;
-	} else if (pid == 0) { /* child i.e filter */
-		sigset_t sigterm_mask;
-		sigemptyset(&sigterm_mask);
-		sigaddset(&sigterm_mask, SIGTERM);
-		if (sigprocmask(SIG_UNBLOCK, &sigterm_mask, NULL) == -1) {
-			fprintf(stderr, "failed to reset signal mask");
-			exit(EXIT_FAILURE);
-		}
+	int *pipes[] = {pin, pout, perr};
+	for (size_t i = 0; i < LENGTH(pipes); i++) {
+		fcntl(pipes[i][0], F_SETFD, FD_CLOEXEC);
+		fcntl(pipes[i][1], F_SETFD, FD_CLOEXEC);
+	}
 
-		int null = open("/dev/null", O_RDWR);
-		if (null == -1) {
-			fprintf(stderr, "failed to open /dev/null");
-			exit(EXIT_FAILURE);
-		}
+	int null = open("/dev/null", O_RDWR|O_CLOEXEC);
+	if (null == -1) {
+		vis_info_show(vis, "failed to open /dev/null: %s", strerror(errno));
+		goto err_pipes;
+	}
 
-		if (!interactive) {
-			/* If we have nothing to write, let stdin point to
-			 * /dev/null instead of a pipe which is immediately
-			 * closed. Some programs behave differently when used
-			 * in a pipeline.
-			 */
-			if (text_range_valid(range) && text_range_size(range) == 0)
-				dup2(null, STDIN_FILENO);
-			else
-				dup2(pin[0], STDIN_FILENO);
-		}
+	int fds[3];
+	if (interactive) {
+		/* keyboard input is passed through, output goes to the terminal */
+		fds[0] = -1;
+		fds[1] = STDERR_FILENO;
+		fds[2] = -1;
+	} else {
+		/* If we have nothing to write, let stdin point to
+		 * /dev/null instead of a pipe which is immediately
+		 * closed. Some programs behave differently when used
+		 * in a pipeline.
+		 */
+		fds[0] = text_range_valid(range) && text_range_size(range) == 0 ? null : pin[0];
+		fds[1] = read_stdout ? pout[1] : null;
+		fds[2] = read_stderr ? perr[1] : null;
+	}
 
-		close(pin[0]);
-		close(pin[1]);
-		if (interactive) {
-			dup2(STDERR_FILENO, STDOUT_FILENO);
-			/* For some reason the first byte written by the
-			 * interactive application is not being displayed.
-			 * It probably has something to do with the terminal
-			 * state change. By writing a dummy byte ourself we
-			 * ensure that the complete output is visible.
-			 */
-			while(write(STDOUT_FILENO, " ", 1) == -1 && errno == EINTR);
-		} else if (read_stdout) {
-			dup2(pout[1], STDOUT_FILENO);
-		} else {
-			dup2(null, STDOUT_FILENO);
-		}
-		close(pout[1]);
-		close(pout[0]);
-		if (!interactive) {
-			if (read_stderr)
-				dup2(perr[1], STDERR_FILENO);
-			else
-				dup2(null, STDERR_FILENO);
-		}
-		close(perr[0]);
-		close(perr[1]);
-		close(null);
-
-		if (file) {
-			str8 name;
-			path_split(file->filepath, 0, &name);
-			setenv("vis_filepath", file->filepath.data ? (char *)file->filepath.data : "", 1);
-			setenv("vis_filename", name.length > 0     ? (char *)name.data           : "", 1);
-		}
+	ui_terminal_save(&vis->ui, fullscreen);
+	if (interactive) {
+		/* For some reason the first byte written by the
+		 * interactive application is not being displayed.
+		 * It probably has something to do with the terminal
+		 * state change. By writing a dummy byte ourself we
+		 * ensure that the complete output is visible.
+		 */
+		while(write(STDERR_FILENO, " ", 1) == -1 && errno == EINTR);
+	}
+	pid_t pid = vis_spawn(vis, file, argv, fds);
+	close(null);
 
-		if (!argv[1])
-			execlp(vis->shell, vis->shell, "-c", argv[0], (char*)NULL);
-		else
-			execvp(argv[0], (char* const*)argv);
-		fprintf(stderr, "exec failure: %s", strerror(errno));
-		exit(EXIT_FAILURE);
+	if (pid == -1) {
+		vis_info_show(vis, "spawn failure: %s", strerror(errno));
+		ui_terminal_restore(&vis->ui);
+		goto err_pipes;
 	}
 
 	vis->interrupted = false;
@@ -1679,9 +1745,12 @@ static int _vis_pipe(Vis *vis, File *file, Filerange range, const char* buf, con
 	close(pout[1]);
 	close(perr[1]);
 
-	if (fcntl(pout[0], F_SETFL, O_NONBLOCK) == -1 ||
+	if (fcntl(pin[1], F_SETFL, O_NONBLOCK) == -1 ||
+	    fcntl(pout[0], F_SETFL, O_NONBLOCK) == -1 ||
 	    fcntl(perr[0], F_SETFL, O_NONBLOCK) == -1)
 		goto err;
+	if (text_range_size(rout))
+		pipe_enlarge(pin[1]);
 
 	fd_set rfds, wfds;
 
@@ -1709,11 +1778,11 @@ static int _vis_pipe(Vis *vis, File *file, Filerange range, const char* buf, con
 
 		if (pin[1] != -1 && FD_ISSET(pin[1], &wfds)) {
 			ssize_t written = 0;
-			Filerange junk = rout;
 			if (text_range_size(rout)) {
-				if (junk.end > junk.start + PIPE_BUF)
-					junk.end = junk.start + PIPE_BUF;
-				written = text_write_range(text, junk, pin[1]);
+				/* as much as the pipe takes, the text stays unchanged until the command exits */
+				written = text_pipe_range(text, rout, pin[1]);
+				if (written == -1 && (errno == EAGAIN || errno == EINTR))
+					continue;
 				if (written > 0) {
 					rout.start += written;
 					if (text_range_size(rout) == 0) {
@@ -1808,6 +1877,15 @@ err:
 		return WEXITSTATUS(status);
 
 	return -1;
+
+err_pipes:
+	close(pin[0]);
+	close(pin[1]);
+	close(pout[0]);
+	close(pout[1]);
+	close(perr[0]);
+	close(perr[1]);
+	return -1;
 }
 
 int vis_pipe(Vis *vis, File *file, Filerange range, const char *argv[],